@@ -0,0 +1,51 @@
+#include "option_pricer.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+// Reports Black-76 pricing and implied vol throughput in contracts per second.
+int main(int argc, char** argv) {
+    size_t contracts = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+    int rounds = 10;
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> strike(20000.0, 120000.0);
+    std::uniform_real_distribution<double> expiry(1.0 / 365.0, 1.5);
+    std::uniform_real_distribution<double> vol(0.3, 1.2);
+
+    OptionChain chain;
+    for (size_t i = 0; i < contracts; ++i) {
+        chain.add(60000.0, strike(rng), expiry(rng), i % 2 == 0, vol(rng));
+    }
+
+    OptionPricer pricer(PricingModel::Black76, threads);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        pricer.price(chain);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "price+greeks: " << static_cast<double>(contracts * rounds) / seconds
+              << " contracts/s (" << pricer.threads() << " threads)" << std::endl;
+
+    chain.market_price = chain.price;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        pricer.impliedVol(chain);
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "implied vol:  " << static_cast<double>(contracts * rounds) / seconds
+              << " contracts/s (" << pricer.threads() << " threads)" << std::endl;
+
+    double max_error = 0.0;
+    size_t solved = 0;
+    for (size_t i = 0; i < contracts; ++i) {
+        if (chain.implied_vol[i] > 0.0) {
+            max_error = std::max(max_error, std::abs(chain.implied_vol[i] - chain.volatility[i]));
+            ++solved;
+        }
+    }
+    std::cout << "implied vol solved " << solved << "/" << contracts << ", max |error| " << max_error << std::endl;
+    return 0;
+}
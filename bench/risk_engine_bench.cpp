@@ -0,0 +1,63 @@
+#include "risk_engine.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Reports pre-trade check latency, single-threaded and with threads checking
+// different instruments at once. Every accepted check is released again so
+// the limits never fill up.
+int main(int argc, char** argv) {
+    size_t checks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    threads = threads == 0 ? 1 : threads;
+
+    RiskLimits limits;
+    limits.max_order_size = 100.0;
+    limits.max_order_notional = 1e7;
+    limits.max_position = 1000.0;
+    limits.max_position_notional = 1e8;
+    limits.price_band = 0.05;
+    limits.max_open_orders = 100;
+
+    RiskEngine risk;
+    std::vector<uint32_t> ids;
+    for (size_t i = 0; i < threads; ++i) {
+        ids.push_back(risk.addInstrument("BENCH-" + std::to_string(i), "BTC", limits));
+        risk.setBbo(ids.back(), 60000.0, 60000.5);
+    }
+    risk.setCurrencyLimit("BTC", 1e12);
+
+    auto run = [&](uint32_t id, size_t count) {
+        size_t accepted = 0;
+        for (size_t i = 0; i < count; ++i) {
+            Side side = i % 2 == 0 ? Side::Bid : Side::Ask;
+            double price = side == Side::Bid ? 59990.0 : 60010.5;
+            if (risk.check(id, side, 1.0 + static_cast<double>(i % 10), price, 0) == RiskResult::Accepted) {
+                risk.onOrderDone(id, side, 1.0 + static_cast<double>(i % 10));
+                ++accepted;
+            }
+        }
+        return accepted;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    size_t accepted = run(ids[0], checks);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "check+release: " << seconds * 1e9 / static_cast<double>(checks) << " ns ("
+              << accepted << "/" << checks << " accepted)" << std::endl;
+
+    std::vector<std::thread> workers;
+    start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] { run(ids[t], checks / threads); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "check+release: " << static_cast<double>(checks) / seconds << " checks/s ("
+              << threads << " threads)" << std::endl;
+    return 0;
+}
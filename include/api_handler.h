@@ -1,6 +1,8 @@
 #ifndef API_HANDLER_H
 #define API_HANDLER_H
 
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
@@ -8,16 +10,37 @@ class APIHandler {
 public:
     APIHandler(const std::string& client_id, const std::string& client_secret);
     bool authenticate();
-    std::string placeOrder(const std::string& instrument, double quantity, const std::string& side);
-    bool cancelOrder(const std::string& order_id);
+    // price > 0 places a limit order, otherwise a market order. label is
+    // echoed back by the exchange on every update of the order.
+    std::string placeOrder(const std::string& instrument, double quantity, const std::string& side,
+                           const std::string& label = "", double price = 0.0);
+    // Returns the raw reply: the cancelled order as result, or an error.
+    std::string cancelOrder(const std::string& order_id);
+    // Mass cancels in one request. Detailed replies: the result lists the
+    // cancelled orders, grouped per instrument and order type.
+    std::string cancelAll();
+    std::string cancelAllByInstrument(const std::string& instrument);
+    std::string cancelAllByCurrency(const std::string& currency, const std::string& kind = "any");
     std::string getOrderBook(const std::string& instrument);
+    // Unexpired instruments of a currency.
+    std::string getInstruments(const std::string& currency, const std::string& kind = "any");
+    // Trades with trade_seq >= start_seq, or the most recent count when start_seq is 0.
+    std::string getLastTrades(const std::string& instrument, uint64_t start_seq = 0, int count = 100);
     std::string getPositions(const std::string& currency, std::string kind);
-    std::string modifyOrder(const std::string& order_id, double amount);
+    std::string getOpenOrders(const std::string& currency, const std::string& kind = "any");
+    std::string getOrderState(const std::string& order_id);
+    // Orders carrying label, as an array; empty if the exchange never had one.
+    std::string getOrderStateByLabel(const std::string& currency, const std::string& label);
+    std::string modifyOrder(const std::string& order_id, double amount, double price = 0.0);
+    // Safe to call from any thread; requests may run concurrently.
+    std::string accessToken() const;
 
 private:
     std::string client_id_;
     std::string client_secret_;
     std::string access_token_;
+    mutable std::mutex token_mutex_;  // guards access_token_
+    void setAccessToken(const std::string& token);
     std::string makeRequest(const std::string& endpoint, const std::string& payload);
 };
 
@@ -0,0 +1,79 @@
+#ifndef CANDLE_AGGREGATOR_H
+#define CANDLE_AGGREGATOR_H
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "market_types.h"
+#include "trade_tape.h"
+
+struct Candle {
+    int64_t start = 0;  // ms, aligned to the timeframe
+    double open = 0.0;
+    double high = 0.0;
+    double low = 0.0;
+    double close = 0.0;
+    double volume = 0.0;
+    uint32_t trades = 0;
+};
+
+nlohmann::json toJson(const Candle& candle);
+
+// OHLCV candles for several timeframes built from the trade tape. Each
+// trade updates the open candle of every timeframe in O(1); closed candles
+// stay in a per-instrument ring of bounded length. Periods without trades
+// produce no candle.
+class CandleAggregator {
+public:
+    // Called with each candle a batch of trades touched, oldest first.
+    using CandleListener = std::function<void(const std::string& instrument, const std::string& timeframe,
+                                              const Candle& candle)>;
+
+    // Timeframes are labels such as "1s", "1m", "5m", "1h" or "1d".
+    explicit CandleAggregator(std::vector<std::string> timeframes = {"1s", "1m", "5m", "1h"},
+                              size_t history = 1440);
+
+    // Consumes the tape records [first, end), as passed to a TradeTape listener.
+    void onTrades(const std::string& instrument, const TradeRing& ring, uint64_t first, uint64_t end);
+    // Up to limit most recent candles, oldest first; the last may still be open.
+    std::vector<Candle> history(const std::string& instrument, std::string_view timeframe, size_t limit) const;
+    bool hasTimeframe(std::string_view timeframe) const;
+
+    void addListener(CandleListener listener);
+
+    // Period in ms, or 0 if the label is not understood.
+    static int64_t parseTimeframe(std::string_view timeframe);
+
+private:
+    struct Series {
+        std::vector<Candle> ring;
+        size_t head = 0;   // slot of the newest candle
+        size_t count = 0;
+    };
+
+    struct Entry {
+        mutable std::mutex mutex;
+        std::vector<Series> series;  // parallel to timeframes_
+    };
+
+    Entry& entry(const std::string& instrument);
+    const Entry* find(const std::string& instrument) const;
+    // False if the trade is older than every candle still held.
+    bool apply(Series& series, int64_t period, const Trade& trade, int64_t& start);
+
+    std::vector<std::string> timeframes_;
+    std::vector<int64_t> periods_;
+    size_t history_;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries_;
+    std::vector<CandleListener> listeners_;
+    mutable std::shared_mutex mutex_;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef CONTROL_MESSAGE_H
+#define CONTROL_MESSAGE_H
+
+#include <cstdint>
+#include <string_view>
+
+enum class ControlType {
+    Unknown,
+    Subscribe,
+    Unsubscribe,
+    Compression, // {"type":"compression","mode":"deflate"|"none"}
+    Snapshot,    // {"type":"snapshot","symbol":...} asks for a fresh snapshot after a sequence gap
+    Resume,      // {"type":"resume","symbol":...,"last_seq":N} replays deltas after N on reconnect
+    History      // {"type":"history","symbol":"candles.{instrument}.{timeframe}","limit":N}
+};
+
+// A client request on the WebSocket server. Subscribe may carry
+// "encoding":"json"|"binary" to pick the session's wire format, and
+// "interval_ms":N or "max_rate":N (updates per second) to have updates
+// conflated to at most one per interval. Views point into the buffer that
+// was parsed and are only valid until it is consumed.
+struct ControlMessage {
+    ControlType type = ControlType::Unknown;
+    std::string_view symbol;
+    std::string_view mode;
+    std::string_view encoding;
+    uint64_t last_seq = 0;
+    uint32_t interval_ms = 0;  // 0: every update
+    uint32_t limit = 0;
+};
+
+// In-place parser for the control grammar: a flat JSON object whose values
+// are strings without escapes, numbers, booleans or null, e.g.
+// {"type":"subscribe","symbol":"BTC-PERPETUAL"}. Unknown keys are skipped.
+// Returns false on malformed input; never allocates.
+bool parseControlMessage(std::string_view text, ControlMessage& message);
+
+#endif
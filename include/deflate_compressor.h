@@ -0,0 +1,25 @@
+#ifndef DEFLATE_COMPRESSOR_H
+#define DEFLATE_COMPRESSOR_H
+
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <string>
+#include <string_view>
+
+// Raw DEFLATE with the framing permessage-deflate uses for a message sent
+// without context takeover: every message is compressed from a fresh window,
+// sync-flushed, and the trailing 00 00 ff ff is stripped. Output for a given
+// input is therefore identical for every receiver and can be shared.
+class DeflateCompressor {
+public:
+    explicit DeflateCompressor(int level = 6, int window_bits = 15, int mem_level = 8);
+
+    bool compress(std::string_view input, std::string& output);
+
+private:
+    boost::beast::zlib::deflate_stream stream_;
+    int level_;
+    int window_bits_;
+    int mem_level_;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef EXECUTION_SCHEDULER_H
+#define EXECUTION_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "market_types.h"
+#include "order_manager.h"
+#include "timer_wheel.h"
+#include "trade_tape.h"
+
+enum class AlgoType : uint8_t {
+    Twap,     // equal slices every interval over duration
+    Iceberg,  // one child of display size resting at the limit, refilled as it fills
+    Pov       // keeps fills near participation * market volume since start
+};
+
+const char* toString(AlgoType type);
+
+struct AlgoParams {
+    AlgoType type = AlgoType::Twap;
+    std::string instrument;
+    Side side = Side::Bid;
+    double quantity = 0.0;
+    double limit_price = 0.0;  // 0 sends market children; required for iceberg
+    double lot_size = 0.0;     // children are rounded down to a multiple of this
+    std::chrono::milliseconds interval{1000};   // slice spacing / re-evaluation period
+    std::chrono::milliseconds duration{60000};  // TWAP
+    double display = 0.0;                       // iceberg
+    double participation = 0.1;                 // POV
+};
+
+struct AlgoStatus {
+    AlgoParams params;
+    double filled = 0.0;
+    double working = 0.0;  // unfilled quantity of the live child
+    bool done = false;
+    bool cancelled = false;
+};
+
+// Runs parent orders as child orders through OrderManager. Every parent is
+// a timer on one hierarchical wheel advanced by the scheduler's thread, so
+// tens of thousands can be active at O(1) timer cost each. Children due in
+// the same tick go out as one concurrent batch. Fills arrive through the
+// OrderManager's fill listener, the touch through onBook and market volume
+// from the trade tape; deciding the next child never needs a network call.
+// Limit children are priced at the touch when it is inside the limit.
+class ExecutionScheduler {
+public:
+    // Registers a fill listener, so construct before orders flow.
+    explicit ExecutionScheduler(OrderManager& orders,
+                                std::chrono::milliseconds tick = std::chrono::milliseconds(10), size_t slots = 512);
+    ~ExecutionScheduler();
+
+    void start();
+    void stop();
+
+    // Returns the parent id, or 0 if params are unusable.
+    uint64_t submit(const AlgoParams& params);
+    // Stops a parent and cancels its live child.
+    bool cancel(uint64_t parent);
+    bool getStatus(uint64_t parent, AlgoStatus& status) const;
+    size_t active() const;
+    // Drops finished parents; returns how many.
+    size_t purgeFinished();
+
+    void onBook(const std::string& instrument, double bid, double ask);
+    // POV reads market volume (our own fills included) from the tape, so
+    // only trades still held by an instrument's ring count. Set before start.
+    void setTradeTape(const TradeTape* tape);
+
+private:
+    struct Parent {
+        AlgoParams params;
+        TimerWheel::Clock::time_point start;
+        double filled = 0.0;
+        std::string child;              // live child's exchange id, "" if none
+        double child_quantity = 0.0;
+        double child_filled = 0.0;
+        bool cancelling = false;        // TWAP: child cancel sent, next slice waits for it to end
+        int64_t start_ms = 0;           // POV: trades from this timestamp on count
+        const TradeRing* trades = nullptr;
+        std::vector<std::string> children;
+        uint32_t generation = 0;
+        bool done = false;
+        bool cancelled = false;
+    };
+
+    struct Market {
+        double bid = 0.0;
+        double ask = 0.0;
+    };
+
+    // What one evaluation wants sent: cancel_id and/or a child to place.
+    struct Action {
+        uint64_t parent = 0;
+        std::string cancel_id;
+        OrderRequest place;
+    };
+
+    void run();
+    void schedule(uint64_t id, Parent& parent, TimerWheel::Clock::time_point when);
+    void applyFill(uint64_t id, const std::string& child, double quantity);
+    void evaluate(uint64_t id, Parent& parent, bool child_ended, TimerWheel::Clock::time_point now,
+                  std::vector<Action>& actions);
+    void execute(std::vector<Action>& actions);
+    void finish(Parent& parent);
+    double childPrice(const Parent& parent) const;
+    double roundLot(const Parent& parent, double quantity) const;
+
+    OrderManager& orders_;
+    mutable std::mutex mutex_;  // everything below; never held while calling into orders_
+    TimerWheel wheel_;
+    std::unordered_map<uint64_t, Parent> parents_;
+    const TradeTape* tape_ = nullptr;
+    std::unordered_map<std::string, Market> markets_;
+    std::unordered_map<std::string, uint64_t> child_parents_;  // child exchange id -> parent
+    std::unordered_map<std::string, double> unmatched_fills_;  // fills seen while placements are in flight
+    bool placing_ = false;
+    uint64_t next_parent_ = 1;
+    size_t active_ = 0;
+
+    std::atomic<bool> running_{false};
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef MARKET_DATA_H
+#define MARKET_DATA_H
+
+#include <nlohmann/json.hpp>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "order_book.h"
+#include "order_book_analytics.h"
+#include "trade_tape.h"
+
+// Trades from the "result" of public/get_last_trades_by_instrument, ordered
+// by trade_seq and skipping any at or below after_seq.
+std::vector<Trade> parseTrades(const nlohmann::json& result, uint64_t after_seq = 0);
+
+// In-memory books keyed by instrument, each with its analytics stage.
+class MarketData {
+public:
+    using AnalyticsListener = std::function<void(const std::string& instrument, const BookAnalytics& analytics)>;
+
+    // Applies the "result" object of a public/get_order_book response.
+    BookUpdate onOrderBook(const std::string& instrument, const nlohmann::json& result);
+    // Trade volume and VWAP in the analytics are read from the tape's rings;
+    // without one they stay 0. Set before books are applied.
+    void setTradeTape(const TradeTape* tape);
+
+    bool getAnalytics(const std::string& instrument, BookAnalytics& analytics) const;
+    bool getBestBidAsk(const std::string& instrument, PriceLevel& bid, PriceLevel& ask) const;
+    nlohmann::json getBook(const std::string& instrument, size_t depth = 0) const;
+
+    void addAnalyticsListener(AnalyticsListener listener);
+
+private:
+    struct Entry {
+        explicit Entry(const std::string& instrument) : book(instrument) {}
+        mutable std::mutex mutex;
+        OrderBook book;
+        OrderBookAnalytics analytics;
+        const TradeRing* trades = nullptr;  // the ring appears with the first trade
+    };
+
+    Entry& entry(const std::string& instrument);
+    const Entry* find(const std::string& instrument) const;
+    void notify(const std::string& instrument, const BookAnalytics& analytics);
+
+    std::unordered_map<std::string, std::unique_ptr<Entry>> books_;
+    const TradeTape* tape_ = nullptr;
+    std::vector<AnalyticsListener> listeners_;
+    mutable std::shared_mutex mutex_;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef MARKET_TYPES_H
+#define MARKET_TYPES_H
+
+#include <cstdint>
+
+enum class Side : uint8_t {
+    Bid = 0,
+    Ask = 1
+};
+
+struct PriceLevel {
+    double price = 0.0;
+    double amount = 0.0;
+};
+
+// A single price level change; amount 0 removes the level.
+struct LevelDelta {
+    Side side = Side::Bid;
+    double price = 0.0;
+    double amount = 0.0;
+};
+
+// One public trade; side is the taker's (Bid for a buy).
+struct Trade {
+    uint64_t trade_seq = 0;  // per instrument
+    uint64_t trade_id = 0;   // exchange-wide; numeric part of the exchange's id
+    int64_t timestamp = 0;
+    double price = 0.0;
+    double amount = 0.0;
+    Side side = Side::Bid;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef OPTION_PRICER_H
+#define OPTION_PRICER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class PricingModel {
+    Black76,      // forward holds the futures/forward price
+    BlackScholes  // forward holds spot; carry is rate - dividend
+};
+
+// Struct-of-arrays option chain. Inputs are set by the caller, outputs are
+// written by OptionPricer. Every column has size() entries.
+struct OptionChain {
+    // inputs
+    std::vector<double> forward;
+    std::vector<double> strike;
+    std::vector<double> expiry;       // years
+    std::vector<double> rate;
+    std::vector<double> dividend;     // BlackScholes only
+    std::vector<double> is_call;      // 1.0 call, 0.0 put
+    std::vector<double> volatility;
+    std::vector<double> market_price; // input to implied vol inversion
+
+    // outputs
+    std::vector<double> price;
+    std::vector<double> delta;
+    std::vector<double> gamma;
+    std::vector<double> vega;
+    std::vector<double> theta;        // per year
+    std::vector<double> implied_vol;
+
+    size_t size() const { return strike.size(); }
+    void resize(size_t n);
+    size_t add(double forward_price, double strike_price, double expiry_years, bool call,
+               double volatility_value, double rate_value = 0.0, double dividend_value = 0.0);
+};
+
+// Batch pricer over an OptionChain. Kernels are branch-free loops over the
+// columns so the compiler can vectorize them; large chains are split into
+// contiguous ranges across a pool of worker threads started once with the
+// pricer, and one batch runs at a time.
+class OptionPricer {
+public:
+    explicit OptionPricer(PricingModel model = PricingModel::Black76, size_t threads = 0);
+    ~OptionPricer();
+    OptionPricer(const OptionPricer&) = delete;
+    OptionPricer& operator=(const OptionPricer&) = delete;
+
+    void price(OptionChain& chain) const;
+    void price(OptionChain& chain, size_t begin, size_t end) const;
+    // Safeguarded Newton iterations from a Brenner-Subrahmanyam seed; prices
+    // outside the no-arbitrage bounds produce an implied vol of 0.
+    void impliedVol(OptionChain& chain, int iterations = 16) const;
+    void impliedVol(OptionChain& chain, size_t begin, size_t end, int iterations = 16) const;
+
+    size_t threads() const { return threads_; }
+
+private:
+    using Range = std::function<void(size_t begin, size_t end)>;
+
+    void parallel(size_t n, const Range& fn) const;
+    void work(size_t worker);
+
+    PricingModel model_;
+    size_t threads_;
+
+    mutable std::mutex batch_mutex_;  // held by the caller for a whole batch
+    mutable std::mutex mutex_;        // guards the batch state below
+    mutable std::condition_variable start_cv_;
+    mutable std::condition_variable done_cv_;
+    mutable const Range* job_ = nullptr;
+    mutable size_t job_size_ = 0;
+    mutable size_t chunk_ = 0;
+    mutable size_t busy_ = 0;         // workers still running the current batch
+    mutable uint64_t generation_ = 0; // bumped for every batch
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef OPTION_PRICING_ENGINE_H
+#define OPTION_PRICING_ENGINE_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "option_pricer.h"
+
+// Parsed Deribit option name, e.g. BTC-27DEC24-60000-C.
+struct OptionContract {
+    std::string instrument;
+    std::string currency;
+    int64_t expiry_ms = 0;
+    double strike = 0.0;
+    bool is_call = true;
+};
+
+bool parseOptionInstrument(const std::string& instrument, OptionContract& contract);
+
+struct OptionGreeks {
+    double price = 0.0;      // USD
+    double delta = 0.0;
+    double gamma = 0.0;
+    double vega = 0.0;
+    double theta = 0.0;
+    double implied_vol = 0.0;
+    double position = 0.0;
+};
+
+// Keeps one struct-of-arrays chain per currency for the option books and
+// positions we track. An underlying tick reprices that currency's chain in
+// one batch; option quotes only mark their contract for implied vol
+// inversion, which is done for the marked contracts on the next tick.
+class OptionPricingEngine {
+public:
+    // Called outside the lock with each contract added after it is set.
+    using ContractListener = std::function<void(const std::string& instrument)>;
+
+    explicit OptionPricingEngine(size_t threads = 0, double default_vol = 0.6);
+
+    void setContractListener(ContractListener listener);
+
+    // Loads the result of a private/get_positions call with kind=option.
+    bool loadPositions(const std::string& response);
+    bool addContract(const std::string& instrument, double position = 0.0);
+    void setPosition(const std::string& instrument, double position);
+    // Adds a fill's signed quantity to the contract's position; other
+    // instruments are ignored.
+    void onFill(const std::string& instrument, double quantity);
+
+    void onUnderlying(const std::string& currency, double forward, int64_t timestamp_ms);
+    // Best bid/ask of the option book, quoted in the underlying currency.
+    void onOptionQuote(const std::string& instrument, double bid, double ask);
+
+    bool getGreeks(const std::string& instrument, OptionGreeks& greeks) const;
+    // Position-weighted sum over the currency's chain.
+    OptionGreeks portfolioGreeks(const std::string& currency) const;
+    size_t contracts() const;
+    // Names of every tracked contract, whose books have to be fetched.
+    std::vector<std::string> instruments() const;
+
+private:
+    struct Chain {
+        OptionChain soa;
+        std::vector<OptionContract> contracts;
+        std::vector<double> position;
+        std::vector<double> quote;  // option mid in underlying units, 0 if none
+        std::vector<size_t> dirty;  // contracts awaiting implied vol inversion
+        std::vector<uint8_t> is_dirty;
+        std::unordered_map<std::string, size_t> index;
+        double forward = 0.0;
+        int64_t timestamp_ms = 0;
+    };
+
+    // Caller holds the lock and has checked the contract is new.
+    void insert(Chain& chain, OptionContract&& contract, double position);
+    bool locate(const std::string& instrument, const Chain*& chain, size_t& index) const;
+    void reinvert(Chain& chain);
+
+    OptionPricer pricer_;
+    double default_vol_;
+    std::unordered_map<std::string, Chain> chains_;
+    ContractListener contract_listener_;
+    mutable std::mutex mutex_;
+};
+
+#endif
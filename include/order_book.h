@@ -0,0 +1,54 @@
+#ifndef ORDER_BOOK_H
+#define ORDER_BOOK_H
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "market_types.h"
+
+// Level changes that take a book from one sequence number to the next.
+struct BookUpdate {
+    std::string instrument;
+    uint64_t sequence = 0;
+    int64_t timestamp = 0;
+    std::vector<LevelDelta> deltas;
+};
+
+class OrderBook {
+public:
+    using BidLevels = std::map<double, double, std::greater<double>>;
+    using AskLevels = std::map<double, double>;
+    // Called for every applied level with the amount it replaced (0 if new).
+    using LevelListener = std::function<void(const LevelDelta& delta, double previous_amount)>;
+
+    explicit OrderBook(std::string instrument = "");
+
+    // Diffs the "result" object of a public/get_order_book response against this book.
+    BookUpdate diffSnapshot(const nlohmann::json& result) const;
+    void apply(const BookUpdate& update, const LevelListener& on_level = {});
+    double applyDelta(const LevelDelta& delta);
+    void clear();
+
+    const std::string& instrument() const { return instrument_; }
+    uint64_t sequence() const { return sequence_; }
+    int64_t timestamp() const { return timestamp_; }
+    const BidLevels& bids() const { return bids_; }
+    const AskLevels& asks() const { return asks_; }
+    bool bestBid(PriceLevel& level) const;
+    bool bestAsk(PriceLevel& level) const;
+
+    // depth 0 serializes every level.
+    nlohmann::json toJson(size_t depth = 0) const;
+
+private:
+    std::string instrument_;
+    uint64_t sequence_ = 0;
+    int64_t timestamp_ = 0;
+    BidLevels bids_;
+    AskLevels asks_;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef ORDER_BOOK_ANALYTICS_H
+#define ORDER_BOOK_ANALYTICS_H
+
+#include <nlohmann/json.hpp>
+#include <cstddef>
+#include <cstdint>
+#include "order_book.h"
+#include "trade_tape.h"
+
+// Touch values are 0 while the side they need is empty; mid, spread,
+// microprice and top_imbalance need both.
+struct BookAnalytics {
+    uint64_t sequence = 0;
+    int64_t timestamp = 0;
+    double best_bid = 0.0;
+    double best_ask = 0.0;
+    double best_bid_amount = 0.0;
+    double best_ask_amount = 0.0;
+    double mid = 0.0;
+    double microprice = 0.0;
+    double spread = 0.0;
+    double top_imbalance = 0.0;   // (bid size - ask size) / (bid size + ask size) at the touch
+    double bid_depth = 0.0;
+    double ask_depth = 0.0;
+    double depth_imbalance = 0.0; // same ratio over the whole book
+    double bid_vwap = 0.0;        // depth-weighted average price per side
+    double ask_vwap = 0.0;
+    double trade_vwap = 0.0;      // rolling window over trades
+    double trade_volume = 0.0;
+    size_t spread_samples = 0;
+    double spread_mean = 0.0;
+    double spread_stddev = 0.0;
+    double spread_min = 0.0;
+    double spread_max = 0.0;
+};
+
+nlohmann::json toJson(const BookAnalytics& analytics);
+
+// Book metrics maintained from level deltas. Each delta costs O(1): depth and
+// notional totals are adjusted by the change in amount at that level, and the
+// touch-derived values only read the first level of each side.
+class OrderBookAnalytics {
+public:
+    explicit OrderBookAnalytics(int64_t trade_window_ms = 60000);
+
+    void onDelta(const LevelDelta& delta, double previous_amount);
+    // Refreshes top-of-book metrics once a whole update has been applied.
+    void onUpdate(const OrderBook& book);
+    // Rolling trade volume and VWAP over the window ending at the last update.
+    void onTrades(const TradeRing& trades);
+    void reset();
+
+    const BookAnalytics& current() const { return current_; }
+
+private:
+    int64_t trade_window_ms_;
+    double bid_notional_ = 0.0;
+    double ask_notional_ = 0.0;
+    double spread_m2_ = 0.0;
+    BookAnalytics current_;
+};
+
+#endif
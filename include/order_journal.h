@@ -0,0 +1,91 @@
+#ifndef ORDER_JOURNAL_H
+#define ORDER_JOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "order_state_cache.h"
+
+enum class JournalEvent : uint8_t {
+    Intent,      // inserted locally, before the request is sent
+    Ack,
+    Fill,
+    Amend,       // any other update of quantity or price
+    Cancel,
+    Reject,
+    Checkpoint   // carried over from the previous journal when it was reopened
+};
+
+const char* toString(JournalEvent event);
+
+// Append-only binary log of every change to our orders, one fixed-size
+// checksummed entry holding the order's full record after the change.
+// Callers only copy their entry into the pending batch; a writer thread
+// writes whatever has accumulated with one write and one flush to disk, so
+// entries arriving during a flush share the next one (group commit) and
+// the order path never waits on the disk. A crash loses at most the
+// entries not yet flushed; sync() waits for them where that matters.
+class OrderJournal {
+public:
+    OrderJournal() = default;
+    ~OrderJournal();
+    OrderJournal(const OrderJournal&) = delete;
+    OrderJournal& operator=(const OrderJournal&) = delete;
+
+    // Replays the journal at path (if any) into recovered: the latest record
+    // of every order that had not finished. The file is then rewritten to
+    // hold just those and the writer thread starts appending to it.
+    bool open(const std::string& path, std::vector<OrderRecord>& recovered);
+    // Writes out everything appended and stops the writer.
+    void close();
+
+    void append(JournalEvent event, const OrderRecord& record);
+    // Blocks until everything appended so far is on disk. False if a write failed.
+    bool sync();
+    uint64_t appended() const;
+    uint64_t durable() const;
+
+    // Reads a journal through a read-only memory mapping, stopping at the
+    // first torn or corrupt entry. Returns false if the file is unusable;
+    // a missing file is an empty journal.
+    static bool replay(const std::string& path, std::vector<OrderRecord>& recovered);
+
+private:
+    struct Entry {
+        uint32_t checksum = 0;  // of everything after this field
+        JournalEvent event = JournalEvent::Intent;
+        uint8_t reserved[3] = {};
+        uint64_t sequence = 0;  // 1, 2, ... within a file
+        OrderRecord record;
+    };
+
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t entry_size;  // journals from a build with another record layout are refused
+        uint32_t reserved;
+    };
+
+    static uint32_t checksum(const Entry& entry);
+    static bool writeFile(const std::string& path, const std::vector<OrderRecord>& records);
+    bool writeBatch(const std::vector<Entry>& batch);
+    void run();
+
+    std::FILE* file_ = nullptr;
+    std::string path_;
+    mutable std::mutex mutex_;  // guards everything below
+    std::condition_variable pending_cv_;
+    std::condition_variable durable_cv_;
+    std::vector<Entry> pending_;
+    uint64_t appended_ = 0;
+    uint64_t durable_ = 0;
+    bool failed_ = false;
+    bool running_ = false;
+    std::thread writer_;
+};
+
+#endif
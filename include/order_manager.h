@@ -1,21 +1,147 @@
 #ifndef ORDER_MANAGER_H
 #define ORDER_MANAGER_H
 
+#include <json/json.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <thread>
+#include <vector>
 #include "api_handler.h"
+#include "order_journal.h"
+#include "order_state_cache.h"
+#include "risk_engine.h"
 
+struct OrderRequest {
+    std::string instrument;
+    double quantity = 0.0;
+    std::string side;    // "buy" or "sell"
+    double price = 0.0;  // 0 for a market order
+};
+
+struct OrderAmend {
+    std::string order_id;
+    double quantity = 0.0;
+    double price = 0.0;
+};
+
+// Per-request outcomes of a batch, in request order.
+struct BatchResult {
+    std::vector<bool> succeeded;
+    std::vector<std::string> order_ids;  // placeOrders: exchange ids, "" where placement failed
+    size_t accepted = 0;
+};
+
+// Safe to use from many threads at once. Orders are sharded by instrument,
+// each shard with its own lock and cache, and exchange order ids map to
+// their shard through a separately striped flat index, so callers trading
+// different instruments never contend. No lock is held across a request.
 class OrderManager {
 public:
     explicit OrderManager(APIHandler& api_handler);
-    std::string placeOrder(const std::string& instrument, double quantity, const std::string& side);
+    // Orders and amends must pass risk's pre-trade checks before they are
+    // sent, and fills and finished orders are reported back to it. Must be
+    // set before orders flow; instruments it does not know are rejected.
+    void setRiskEngine(RiskEngine* risk);
+    // Called for every fill of one of our orders, with the filled quantity and
+    // its price, while the order's shard is locked. Add before orders flow.
+    using FillListener = std::function<void(const OrderRecord& order, double quantity, double price)>;
+    void addFillListener(FillListener listener);
+    // Every intent, acknowledgement, fill, amend and cancel of our orders is
+    // appended to the journal. Must be set before orders flow.
+    void setJournal(OrderJournal* journal);
+    // Adopts orders recovered from the journal, reserving them with the risk
+    // engine, before any new orders are placed. Returns how many were taken.
+    size_t restore(const std::vector<OrderRecord>& orders);
+    // Brings tracked orders of a currency in line with the exchange after a
+    // restart: open orders are applied as updates, and only tracked orders
+    // missing from them are looked up one by one, by exchange id or, if
+    // never acknowledged, by label (not found there: rejected). Call before
+    // placing new orders, as those in flight would look unacknowledged.
+    // Returns how many were looked up.
+    size_t reconcileOpenOrders(const std::string& currency);
+    // price > 0 places a limit order. Returns the exchange order id, or ""
+    // if the order was not accepted.
+    std::string placeOrder(const std::string& instrument, double quantity, const std::string& side, double price = 0.0);
     bool cancelOrder(const std::string& order_id);
-    bool modifyOrder(const std::string& order_id, double new_quantity);
+    // Batches run up to maxInFlight() requests concurrently, each behaving
+    // like the single-order call.
+    BatchResult placeOrders(const std::vector<OrderRequest>& orders);
+    BatchResult modifyOrders(const std::vector<OrderAmend>& amends);
+    BatchResult cancelOrders(const std::vector<std::string>& order_ids);
+    // Exchange mass cancels in one request. The orders the exchange reports
+    // cancelled are applied to ours as updates; others are left as they are.
+    bool cancelAll();
+    bool cancelAllByInstrument(const std::string& instrument);
+    bool cancelAllByCurrency(const std::string& currency);
+    void setMaxInFlight(size_t max_in_flight);
+    size_t maxInFlight() const;
+    // Edits to an order that arrive while one is in flight are coalesced:
+    // only the latest is sent, once the earlier one is answered, and a
+    // cancel drops it. Returns the outcome of this call's edit, or true if
+    // it was queued behind another.
+    bool modifyOrder(const std::string& order_id, double new_quantity, double new_price = 0.0);
+    // Fetched from the exchange; PositionKeeper serves positions locally.
     std::string getPosition(const std::string& currency, std::string kind);
 
+    // Answered from the local order cache, without an exchange round trip.
+    bool getOrder(const std::string& order_id, OrderRecord& order) const;
+    std::vector<OrderRecord> openOrders() const;
+    // Applies an exchange order object (as in buy/sell/edit responses),
+    // matched by our label or by exchange order id.
+    bool applyOrderUpdate(const Json::Value& order);
+
 private:
-    std::unordered_map<std::string, std::string> active_orders_;
+    static constexpr size_t kShards = 16;
+    static constexpr size_t kStripes = 64;
+    static constexpr size_t kPurgeThreshold = 1024;  // per shard; terminal orders are dropped past this size
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        OrderStateCache orders;
+    };
+
+    struct alignas(64) Stripe {
+        mutable std::mutex mutex;
+        ExchangeIdIndex shards;  // exchange order id -> shard
+    };
+
+    uint32_t shardOf(std::string_view instrument) const;
+    // Shard holding an exchange order id, or kShards if unknown.
+    uint32_t shardOfOrder(const std::string& order_id) const;
+    Stripe& stripeOf(std::string_view order_id) const;
+    // Called with the shard's lock held.
+    bool applyOrderUpdate(uint32_t shard, const Json::Value& order);
+    // Reports fills and completion since the given earlier state to the risk
+    // engine and fill listeners.
+    void publishChanges(const OrderRecord& record, double filled_before, double average_before,
+                        OrderState state_before);
+    static int64_t nowMs();
+    // Runs task(0..count-1) on up to max_in_flight_ threads.
+    void dispatch(size_t count, const std::function<void(size_t)>& task);
+    // Applies the exchange's orders under the client id's label; absent is
+    // set if the exchange answered with none.
+    bool lookupByLabel(const std::string& currency, uint64_t client_id, bool& absent);
+    bool rejectUnsent(uint32_t shard, uint64_t client_id);
+    static bool inCurrency(std::string_view instrument, const std::string& currency);
+    bool finishMassCancel(const std::string& response);
+    // Applies every order object found in a detailed mass cancel reply.
+    size_t applyCancelledOrders(const Json::Value& value);
+    // Risk-checks and sends one edit, then applies the reply.
+    bool sendAmend(const std::string& order_id, const OrderRecord* current, double new_quantity, double new_price);
+
     APIHandler& api_handler_;
+    RiskEngine* risk_ = nullptr;
+    OrderJournal* journal_ = nullptr;
+    std::vector<FillListener> fill_listeners_;
+    std::array<Shard, kShards> shards_;
+    mutable std::array<Stripe, kStripes> stripes_;
+    std::atomic<uint64_t> next_client_id_;
+    std::atomic<size_t> max_in_flight_{16};
 };
 
 #endif
@@ -0,0 +1,137 @@
+#ifndef ORDER_STATE_CACHE_H
+#define ORDER_STATE_CACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "market_types.h"
+
+enum class OrderState : uint8_t {
+    New,              // sent, no exchange id yet
+    Acked,            // resting on the book
+    PartiallyFilled,
+    Filled,
+    Cancelled,
+    Rejected
+};
+
+const char* toString(OrderState state);
+bool isTerminal(OrderState state);
+// new -> acked -> partially filled -> filled / cancelled; new -> rejected.
+// A fill may skip acked, and cancelled/filled may follow new for orders
+// that complete within the placement round trip.
+bool canTransition(OrderState from, OrderState to);
+// Deribit order_state ("open", "filled", "cancelled", "rejected", "untriggered").
+OrderState orderStateFromExchange(std::string_view order_state, double filled_amount);
+
+// Fixed-size and trivially copyable so the table is one flat array.
+struct OrderRecord {
+    static constexpr size_t kMaxExchangeId = 31;
+    static constexpr size_t kMaxInstrument = 47;
+    // amend_flags: edits go out one at a time per order; while one is in
+    // flight, later ones collapse into pending_quantity/pending_price.
+    static constexpr uint8_t kAmendInFlight = 1;
+    static constexpr uint8_t kAmendQueued = 2;
+    static constexpr uint8_t kCancelRequested = 4;  // drops any queued edit and refuses new ones
+    static constexpr uint8_t kPlaceInFlight = 8;    // placement not answered yet; reconciliation skips it
+
+    uint64_t client_id = 0;     // 0 marks an empty slot
+    double quantity = 0.0;
+    double price = 0.0;         // 0 for market orders
+    double filled = 0.0;
+    double average_price = 0.0;
+    double pending_quantity = 0.0;
+    double pending_price = 0.0;
+    Side side = Side::Bid;
+    OrderState state = OrderState::New;
+    uint8_t amend_flags = 0;
+    char exchange_id[kMaxExchangeId + 1] = {};
+    char instrument[kMaxInstrument + 1] = {};
+
+    std::string_view exchangeId() const { return exchange_id; }
+    std::string_view instrumentName() const { return instrument; }
+};
+
+// Flat map from exchange order id to a small value, with the cache's
+// hashing and probing: slots hold the id inline, so a lookup touches one
+// array and never allocates.
+class ExchangeIdIndex {
+public:
+    explicit ExchangeIdIndex(size_t capacity = 64);
+
+    // Inserts or overwrites; false if the id is empty or too long.
+    bool insert(std::string_view exchange_id, uint32_t value);
+    bool find(std::string_view exchange_id, uint32_t& value) const;
+    bool erase(std::string_view exchange_id);
+    size_t size() const { return size_; }
+
+    static uint64_t hash(std::string_view exchange_id);  // never 0
+
+private:
+    struct Slot {
+        uint64_t hash = 0;  // 0 marks an empty slot
+        uint32_t value = 0;
+        char id[OrderRecord::kMaxExchangeId + 1] = {};
+    };
+
+    size_t slotOf(uint64_t hash, std::string_view exchange_id) const;
+    void grow();
+
+    std::vector<Slot> slots_;
+    size_t mask_;
+    size_t size_ = 0;
+};
+
+// Orders keyed by locally generated client order id, with a second index
+// from exchange order id. Both are open-addressing tables with linear
+// probing and backward-shift deletion, so there are no tombstones. Pointers
+// returned by insert/find stay valid until the next insert or erase.
+class OrderStateCache {
+public:
+    explicit OrderStateCache(size_t capacity = 1024);
+
+    // Null if the id is taken or a name does not fit its record field.
+    OrderRecord* insert(uint64_t client_id, std::string_view instrument, Side side, double quantity, double price);
+    OrderRecord* find(uint64_t client_id);
+    const OrderRecord* find(uint64_t client_id) const;
+    OrderRecord* findByExchangeId(std::string_view exchange_id);
+    const OrderRecord* findByExchangeId(std::string_view exchange_id) const;
+
+    // Records the exchange id (once) and moves the order along its state
+    // machine; illegal transitions are refused and leave it unchanged.
+    bool acknowledge(OrderRecord& record, std::string_view exchange_id);
+    bool transition(OrderRecord& record, OrderState state);
+    // filled is the cumulative filled amount reported by the exchange.
+    bool applyFill(OrderRecord& record, double filled, double average_price);
+
+    bool erase(uint64_t client_id);
+    // on_erase sees each record just before it is removed.
+    size_t purgeTerminal(const std::function<void(const OrderRecord&)>& on_erase = {});
+    void forEach(const std::function<void(const OrderRecord&)>& fn) const;
+    size_t size() const { return size_; }
+
+    // Client ids travel to the exchange as the order label.
+    static std::string label(uint64_t client_id);
+    static uint64_t parseLabel(std::string_view label);  // 0 if not one of ours
+
+private:
+    struct ExchangeSlot {
+        uint64_t hash = 0;
+        uint64_t client_id = 0;  // 0 marks an empty slot
+    };
+
+    size_t slotOf(uint64_t client_id) const;  // slot holding client_id, or the empty slot ending its probe
+    size_t exchangeSlotOf(uint64_t hash, std::string_view exchange_id) const;
+    void indexExchangeId(const OrderRecord& record);
+    void unindexExchangeId(const OrderRecord& record);
+    void grow();
+
+    std::vector<OrderRecord> records_;
+    std::vector<ExchangeSlot> by_exchange_id_;
+    size_t mask_;
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef POSITION_KEEPER_H
+#define POSITION_KEEPER_H
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "market_types.h"
+
+// PnL is in the settlement currency: coin for inverse futures (size in USD,
+// pnl = size * (1/entry - 1/exit)), otherwise quantity * price difference.
+struct Position {
+    std::string instrument;
+    double size = 0.0;            // signed, negative when short
+    double average_price = 0.0;
+    double mark_price = 0.0;
+    double realized_pnl = 0.0;
+    double unrealized_pnl = 0.0;
+    bool inverse = false;
+};
+
+// Positions seeded once from private/get_positions and then kept current
+// from our own fills and mark-price ticks, so queries never leave the
+// process. reconcile() compares against a fresh exchange snapshot and
+// adopts it for instruments that disagree twice running, which skips over
+// fills that were in flight while the snapshot was taken.
+class PositionKeeper {
+public:
+    // Loads the result of a private/get_positions call, replacing what is
+    // held for the instruments it lists.
+    bool load(const std::string& response);
+    size_t reconcile(const std::string& response);  // returns the number of instruments corrected
+
+    // Replaces one instrument's position with exchange state, e.g. pushed on
+    // user.changes; a mark price of 0 keeps the local mark.
+    void setPosition(const Position& position);
+    void onFill(const std::string& instrument, Side side, double quantity, double price);
+    void onMark(const std::string& instrument, double mark_price);
+
+    bool getPosition(const std::string& instrument, Position& position) const;
+    std::vector<Position> positions() const;
+
+private:
+    struct Entry {
+        mutable std::mutex mutex;
+        Position position;
+        double disputed_size = 0.0;  // exchange size seen at the last reconcile that disagreed
+        bool disputed = false;
+    };
+
+    Entry& entry(const std::string& instrument);
+    Entry* find(const std::string& instrument) const;
+
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries_;
+    mutable std::shared_mutex mutex_;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef QUOTE_ENGINE_H
+#define QUOTE_ENGINE_H
+
+#include <json/json.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "market_types.h"
+#include "order_manager.h"
+
+struct Quote {
+    std::string instrument;
+    Side side = Side::Bid;
+    double price = 0.0;
+    double amount = 0.0;  // resting amount wanted on the book
+};
+
+struct QuoteStats {
+    uint64_t quotes = 0;       // desired quotes submitted
+    uint64_t unchanged = 0;    // already live as desired, nothing sent
+    uint64_t placed = 0;
+    uint64_t amended = 0;
+    uint64_t cancelled = 0;
+    uint64_t messages = 0;     // requests sent to the exchange
+};
+
+// Gets the reply message to a sent request; "error" is set if it failed.
+using QuoteReply = std::function<void(const Json::Value& reply)>;
+// Sends a JSON-RPC request over the authenticated connection, e.g.
+// UserStream::send. on_reply must be called later, never from inside the call.
+using QuoteSender = std::function<bool(const std::string& method, const Json::Value& params, QuoteReply on_reply)>;
+
+// Two-sided quoting for groups of instruments. A strategy submits the whole
+// quote set it wants for a group; the engine diffs it against what is live
+// and sends only the difference. By default quotes are ordinary orders:
+// new sides are placed, changed ones edited (coalesced per order by
+// OrderManager) and dropped ones cancelled, each kind as one concurrent
+// batch. With setMassQuote, a group's changes go out as one mass_quote
+// request, the group name serving as its MMP group; quotes count as live
+// once the exchange has accepted them, and quote order updates fed to
+// onOrderUpdate track their fills and cancels.
+class QuoteEngine {
+public:
+    explicit QuoteEngine(OrderManager& orders);
+
+    // Call before the first submit.
+    void setMassQuote(QuoteSender sender);
+    // At most one quote per instrument and side; a later duplicate wins.
+    // Live quotes of the group missing from desired are pulled. Returns
+    // false if anything failed to go out; the next submit retries it.
+    bool submit(const std::string& group, const std::vector<Quote>& desired);
+    bool cancel(const std::string& group);
+    // Makes the next submit resend the group's quotes in full.
+    void invalidate(const std::string& group);
+    // Mass-quote mode: order objects from the user stream. Quote orders
+    // update what is live; anything else is ignored.
+    void onOrderUpdate(const Json::Value& order);
+    QuoteStats stats() const;
+
+private:
+    struct Live {
+        std::string order_id;  // order mode
+        double price = 0.0;    // mass-quote mode: as accepted, less fills
+        double amount = 0.0;
+    };
+
+    struct Group {
+        std::mutex mutex;  // one submit per group at a time
+        std::unordered_map<std::string, std::array<Live, 2>> live;  // by instrument, [Bid, Ask]
+        uint64_t next_quote_id = 0;
+    };
+
+    using Sides = std::array<const Quote*, 2>;
+
+    Group& group(const std::string& name);
+    bool submitOrders(Group& group, const std::unordered_map<std::string, Sides>& desired);
+    bool submitMassQuote(const std::string& name, Group& group, const std::unordered_map<std::string, Sides>& desired);
+    void onMassQuoteReply(const std::string& name, Group& group, const Json::Value& quotes, const Json::Value& reply);
+
+    OrderManager& orders_;
+    QuoteSender mass_quote_;
+    std::unordered_map<std::string, std::unique_ptr<Group>> groups_;
+    std::mutex groups_mutex_;
+    std::atomic<uint64_t> quotes_{0};
+    std::atomic<uint64_t> unchanged_{0};
+    std::atomic<uint64_t> placed_{0};
+    std::atomic<uint64_t> amended_{0};
+    std::atomic<uint64_t> cancelled_{0};
+    std::atomic<uint64_t> messages_{0};
+};
+
+#endif
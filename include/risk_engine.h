@@ -0,0 +1,113 @@
+#ifndef RISK_ENGINE_H
+#define RISK_ENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "market_types.h"
+
+enum class RiskResult : uint8_t {
+    Accepted,
+    UnknownInstrument,
+    OrderSize,
+    OrderNotional,
+    Position,
+    PositionNotional,
+    CurrencyNotional,
+    PriceBand,
+    NoReferencePrice,
+    OpenOrders,
+    RateLimit
+};
+
+const char* toString(RiskResult result);
+
+// A limit of 0 disables that check.
+struct RiskLimits {
+    double max_order_size = 0.0;          // contracts per order
+    double max_order_notional = 0.0;      // quantity * reference price
+    double max_position = 0.0;            // |position + open orders on that side|
+    double max_position_notional = 0.0;
+    double price_band = 0.0;              // fraction beyond the far touch a limit may be placed
+    uint32_t max_open_orders = 0;
+    uint32_t max_orders_per_second = 0;
+};
+
+// Pre-trade checks against cached positions and BBOs. Instruments and
+// currencies are registered up front; after that, check() and every update
+// touch only atomics in preallocated slots: no locks and no allocation.
+// An accepted check reserves its open-order slot and quantity, which are
+// given back through onFill/onOrderDone, so concurrent checks cannot both
+// take the last unit of a limit.
+class RiskEngine {
+public:
+    explicit RiskEngine(uint32_t max_orders_per_second = 0);
+
+    // Not thread-safe: call before orders flow. Returns the instrument id.
+    uint32_t addInstrument(const std::string& instrument, const std::string& currency, const RiskLimits& limits);
+    void setCurrencyLimit(const std::string& currency, double max_gross_notional);
+    // UINT32_MAX if not registered.
+    uint32_t find(const std::string& instrument) const;
+
+    RiskResult check(uint32_t id, Side side, double quantity, double price, int64_t now_ms);
+    // Checks an amend against its new quantity and price and reserves any
+    // increase. A decrease is handed back with release() once it is confirmed.
+    RiskResult checkAmend(uint32_t id, Side side, double old_quantity, double new_quantity, double price, int64_t now_ms);
+    void release(uint32_t id, Side side, double quantity);
+
+    void setBbo(uint32_t id, double bid, double ask);
+    void setPosition(uint32_t id, double position);
+    void onFill(uint32_t id, Side side, double quantity);
+    // The order left the book with remaining unfilled quantity.
+    void onOrderDone(uint32_t id, Side side, double remaining);
+    // Takes the slot and quantity of an order already on the book, as if it
+    // had passed check(); used when orders are recovered after a restart.
+    void onOrderRestored(uint32_t id, Side side, double remaining);
+
+    double position(uint32_t id) const;
+    uint32_t openOrders(uint32_t id) const;
+
+private:
+    // Fixed-window counter packed as window id << 32 | count.
+    class RateLimiter {
+    public:
+        bool tryAcquire(uint32_t per_second, int64_t now_ms);
+
+    private:
+        std::atomic<uint64_t> state_{0};
+    };
+
+    struct alignas(64) Instrument {
+        RiskLimits limits;
+        uint32_t currency = 0;
+        std::atomic<double> bid{0.0};
+        std::atomic<double> ask{0.0};
+        std::atomic<double> position{0.0};
+        std::atomic<double> open_buy{0.0};
+        std::atomic<double> open_sell{0.0};
+        std::atomic<uint32_t> open_orders{0};
+        RateLimiter rate;
+    };
+
+    struct Currency {
+        double max_gross_notional = 0.0;  // over all its instruments' worst-case positions at mid
+        std::vector<uint32_t> instruments;
+    };
+
+    RiskResult evaluate(uint32_t id, Side side, double quantity, double reserve, double price, int64_t now_ms,
+                        bool new_order);
+    void adjustExposure(Instrument& instrument, Side side, double delta);
+    double worstNotional(const Instrument& instrument) const;
+
+    std::vector<std::unique_ptr<Instrument>> instruments_;
+    std::vector<std::unique_ptr<Currency>> currencies_;
+    std::unordered_map<std::string, uint32_t> instrument_ids_;
+    std::unordered_map<std::string, uint32_t> currency_ids_;
+    uint32_t max_orders_per_second_;
+    RateLimiter rate_;
+};
+
+#endif
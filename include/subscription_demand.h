@@ -0,0 +1,48 @@
+#ifndef SUBSCRIPTION_DEMAND_H
+#define SUBSCRIPTION_DEMAND_H
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Reference-counted interest in upstream symbols. A symbol becomes active on
+// its first reference and stays active for a grace period after its last one
+// is released, so a client that reconnects does not restart the feed. Only
+// symbols in the universe (the exchange's instrument list) can be acquired.
+class SubscriptionDemand {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Called with active=true when a symbol's feed should start and false
+    // once it should stop. Never called with the internal lock held.
+    using Listener = std::function<void(const std::string& symbol, bool active)>;
+
+    explicit SubscriptionDemand(Clock::duration grace = std::chrono::seconds(30));
+
+    void setListener(Listener listener);
+    // Replaces the symbols that may be acquired; active ones stay active.
+    void setUniverse(const std::vector<std::string>& symbols);
+    bool known(const std::string& symbol) const;
+    // False, and nothing acquired, for a symbol outside the universe.
+    bool acquire(const std::string& symbol);
+    void release(const std::string& symbol);
+    // Symbols to fetch; those idle past the grace period are dropped here.
+    std::vector<std::string> active(Clock::time_point now = Clock::now());
+
+private:
+    struct Entry {
+        size_t refs = 0;
+        Clock::time_point released_at;
+    };
+
+    Clock::duration grace_;
+    Listener listener_;
+    mutable std::mutex mutex_;
+    std::unordered_set<std::string> universe_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef TICK_STORE_H
+#define TICK_STORE_H
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <shared_mutex>
+#include "market_types.h"
+
+// Column vectors for a run of order book rows. Each captured book contributes
+// one row per price level, bids first, ordered by level.
+struct TickColumns {
+    std::vector<int64_t> timestamp;
+    std::vector<double> price;
+    std::vector<double> size;
+    std::vector<uint8_t> side;
+    std::vector<uint8_t> level;
+
+    size_t rows() const { return timestamp.size(); }
+    void clear();
+    void reserve(size_t n);
+    void push(int64_t ts, Side s, uint8_t lvl, double px, double sz);
+};
+
+struct SpreadStats {
+    size_t count = 0;
+    double mean = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    double stddev = 0.0;
+};
+
+// Columnar store of captured order book levels. Rows are appended into an
+// open block; full blocks are sealed into delta/varint compressed columns
+// with a timestamp zone map so range queries only decode overlapping blocks.
+class TickStore {
+public:
+    explicit TickStore(size_t block_rows = 4096);
+
+    void append(int64_t timestamp, Side side, uint8_t level, double price, double size);
+    // Captures the "result" object of a public/get_order_book response.
+    bool appendOrderBook(const nlohmann::json& result);
+    void seal();
+
+    bool save(const std::string& filepath);
+    // Only into an empty store: fails rather than drop rows already appended.
+    bool load(const std::string& filepath);
+
+    size_t rows() const;
+    size_t blocks() const;
+    size_t compressedBytes() const;
+
+    TickColumns scan(int64_t from, int64_t to) const;
+    double vwap(int64_t from, int64_t to, Side side) const;
+    SpreadStats spreadStats(int64_t from, int64_t to) const;
+    TickColumns depthAtLevel(int64_t from, int64_t to, Side side, uint8_t level) const;
+
+private:
+    struct Block {
+        uint32_t rows = 0;
+        int64_t ts_min = 0;
+        int64_t ts_max = 0;
+        std::vector<uint8_t> data;
+    };
+
+    void sealLocked();
+    // False if the block's data is malformed; out is then unspecified.
+    static bool decode(const Block& block, TickColumns& out);
+    template <typename Fn>
+    void forEachRun(int64_t from, int64_t to, Fn&& fn) const;
+
+    size_t block_rows_;
+    std::vector<Block> blocks_;
+    TickColumns open_;
+    mutable std::shared_mutex mutex_;
+};
+
+#endif
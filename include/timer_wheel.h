@@ -0,0 +1,54 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Hierarchical timing wheel. Level 0 has one bucket per tick; each level
+// above covers slots times the span of the one below, and its buckets are
+// cascaded down as the level below wraps. Scheduling is O(1), and each tick
+// costs one bucket plus amortized O(1) cascading per timer, however far out
+// timers are. Deadlines past the top level wait there and are re-filed each
+// time their bucket comes round. Timers are plain ids and cannot be
+// cancelled; owners tag ids with a generation and ignore stale ones.
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimerWheel(Clock::duration tick, size_t slots, Clock::time_point start = Clock::now(), size_t levels = 4);
+
+    // Deadlines are rounded up to the next tick; past deadlines fire on the
+    // next advance.
+    void schedule(Clock::time_point deadline, uint64_t id);
+    // Fires every timer due at or before now, in deadline order. fire may
+    // schedule new timers; they fire on a later advance.
+    void advance(Clock::time_point now, const std::function<void(uint64_t id)>& fire);
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    Clock::duration tick() const { return tick_; }
+
+private:
+    struct Timer {
+        uint64_t id;
+        uint64_t expiry;  // absolute tick
+    };
+
+    void insert(const Timer& timer);
+    void cascade(size_t level, uint64_t tick);
+    void collectAll(uint64_t target);
+
+    Clock::duration tick_;
+    Clock::time_point start_;
+    uint64_t slots_;
+    std::vector<uint64_t> spans_;                      // ticks per bucket at each level
+    std::vector<std::vector<std::vector<Timer>>> levels_;
+    std::vector<Timer> due_;
+    std::vector<Timer> refile_;
+    uint64_t current_ = 0;  // next tick to process
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef TRADE_TAPE_H
+#define TRADE_TAPE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "market_types.h"
+
+// Fixed-capacity ring of one instrument's recent trades. One thread appends;
+// any number of threads read concurrently without locks. Each record carries
+// running volume and notional totals, so time-window queries are a binary
+// search over the (time-ordered) ring plus two record reads. Indices are
+// absolute: trade i lives in slot i % capacity until overwritten.
+class TradeRing {
+public:
+    explicit TradeRing(size_t capacity = 65536);  // rounded up to a power of two
+
+    void push(const Trade& trade);  // writer thread only
+
+    uint64_t begin() const;  // oldest index still held
+    uint64_t end() const;    // one past the newest
+    // False if the record was overwritten before or while it was read.
+    bool read(uint64_t index, Trade& trade) const;
+    // Calls fn for each record in [first, end) still held; returns how many.
+    size_t forEach(uint64_t first, uint64_t end, const std::function<void(const Trade&)>& fn) const;
+
+    // First index whose timestamp is >= timestamp (end() if none).
+    uint64_t lowerBound(int64_t timestamp) const;
+    double volumeSince(int64_t timestamp) const;
+    double vwapSince(int64_t timestamp) const;  // 0 if no trades
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> trade_seq{0};
+        std::atomic<uint64_t> trade_id{0};
+        std::atomic<int64_t> timestamp{0};
+        std::atomic<double> price{0.0};
+        std::atomic<double> amount{0.0};
+        std::atomic<double> cum_volume{0.0};    // including this trade
+        std::atomic<double> cum_notional{0.0};
+        std::atomic<uint8_t> side{0};
+    };
+
+    bool readSlot(uint64_t index, Trade& trade, double& cum_volume, double& cum_notional) const;
+    // Volume and notional of [first, end()), or false if the range moved under us.
+    bool totalsSince(uint64_t first, double& volume, double& notional) const;
+
+    std::unique_ptr<Slot[]> slots_;
+    uint64_t mask_;
+    alignas(64) std::atomic<uint64_t> end_{0};
+    double cum_volume_ = 0.0;  // writer only
+    double cum_notional_ = 0.0;
+};
+
+// One TradeRing per instrument. append() must be called from a single
+// writer thread; rings are never removed, so pointers from find() stay valid.
+class TradeTape {
+public:
+    // Called after append with the indices [first, end) just added.
+    using Listener = std::function<void(const std::string& instrument, const TradeRing& ring,
+                                        uint64_t first, uint64_t end)>;
+
+    explicit TradeTape(size_t capacity = 65536);
+
+    void append(const std::string& instrument, const std::vector<Trade>& trades);
+    const TradeRing* find(const std::string& instrument) const;
+    void addListener(Listener listener);
+
+private:
+    size_t capacity_;
+    std::unordered_map<std::string, std::unique_ptr<TradeRing>> rings_;
+    std::vector<Listener> listeners_;
+    mutable std::shared_mutex mutex_;
+};
+
+#endif
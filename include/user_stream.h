@@ -0,0 +1,91 @@
+#ifndef USER_STREAM_H
+#define USER_STREAM_H
+
+#include <boost/asio/io_context.hpp>
+#include <json/json.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "order_manager.h"
+#include "position_keeper.h"
+
+// Persistent authenticated WebSocket to the exchange carrying our private
+// user.orders, user.trades and user.changes channels. Order objects are
+// applied to the OrderManager as they arrive, so fills reach its listeners
+// with streaming latency; positions in user.changes replace the keeper's
+// and are passed to position listeners.
+// Fills are derived from each order's cumulative filled amount, so the same
+// order seen on several channels is applied once. Trades are passed to
+// trade listeners only; order objects also go to order listeners, which
+// is how QuoteEngine sees its mass quote orders. Reconnects with backoff, re-authenticating and
+// resubscribing each time.
+class UserStream {
+public:
+    using TradeListener = std::function<void(const Json::Value& trade)>;
+    using PositionListener = std::function<void(const Json::Value& position)>;
+    using OrderListener = std::function<void(const Json::Value& order)>;
+    // Gets the whole reply message; "error" is set if the request failed.
+    using ReplyHandler = std::function<void(const Json::Value& reply)>;
+
+    UserStream(const std::string& client_id, const std::string& client_secret, OrderManager& orders,
+               PositionKeeper* positions = nullptr);
+    ~UserStream();
+
+    // Listeners are called on the stream's thread; add them before start().
+    void addTradeListener(TradeListener listener);
+    void addPositionListener(PositionListener listener);
+    // Every order object from user.orders and user.changes, ours or not.
+    void addOrderListener(OrderListener listener);
+    // Has the exchange cancel all our open orders whenever this connection
+    // drops, so a crash or network loss cannot leave orders unattended.
+    // Set before start(); re-enabled on every reconnect.
+    void setCancelOnDisconnect(bool enabled);
+    void start();
+    void stop();
+    bool connected() const;
+    // Queues a JSON-RPC request on the authenticated connection; safe from
+    // any thread. False if not connected. Errors in the reply are logged.
+    // on_reply is called later on the stream's thread, never from inside
+    // send; if the connection drops first it gets an error instead.
+    bool send(const std::string& method, const Json::Value& params, ReplyHandler on_reply = {});
+
+private:
+    static constexpr int kHeartbeatSeconds = 10;
+
+    void run();
+    void session();
+    void handleMessage(const std::string& text);
+    void handleNotification(const std::string& channel, const Json::Value& data);
+    void applyPosition(const Json::Value& position);
+    std::string request(const std::string& method, const Json::Value& params);
+    std::string request(uint64_t id, const std::string& method, const Json::Value& params);
+
+    std::string client_id_;
+    std::string client_secret_;
+    OrderManager& orders_;
+    PositionKeeper* positions_;
+    std::vector<TradeListener> trade_listeners_;
+    std::vector<PositionListener> position_listeners_;
+    std::vector<OrderListener> order_listeners_;
+    std::vector<std::string> outbox_;  // requests queued by handlers, written by the session loop
+    std::mutex send_mutex_;
+    std::vector<std::string> sent_;    // requests from send(), moved to outbox_ by the session loop
+    std::unordered_map<uint64_t, ReplyHandler> replies_;  // by request id, guarded by send_mutex_
+    boost::asio::io_context* session_context_ = nullptr;  // set while connected, to wake the loop
+    bool cancel_on_disconnect_ = false;
+    std::atomic<uint64_t> next_request_id_{1};
+    uint64_t auth_request_id_ = 0;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> connected_{false};
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;  // wakes the reconnect backoff on stop()
+    std::thread thread_;
+};
+
+#endif
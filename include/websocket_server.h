@@ -4,33 +4,235 @@
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
 #include <nlohmann/json.hpp>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include "candle_aggregator.h"
+#include "control_message.h"
+#include "deflate_compressor.h"
+#include "market_types.h"
+#include "order_book.h"
+#include "subscription_demand.h"
+#include "timer_wheel.h"
 #include <unordered_map>
-#include <unordered_set>
 #include <string>
+#include <string_view>
 #include <memory>
-#include <shared_mutex>
+#include <optional>
+#include <vector>
 
 using namespace boost::asio;
 using namespace boost::beast;
 using json = nlohmann::json;
 
+enum class Encoding : uint8_t {
+    Json,
+    Binary  // wire_protocol.h
+};
+
+struct OutboundMessage {
+    std::shared_ptr<const std::string> payload;
+    bool binary = false;
+};
+
+// One client connection. Sessions live in the server's slab and keep their
+// buffers across reuse; all fields are only touched on the io_context thread.
+struct Session {
+    std::optional<websocket::stream<boost::asio::ip::tcp::socket>> ws;
+    boost::beast::flat_buffer read_buffer;
+    boost::beast::http::request<boost::beast::http::string_body> upgrade_request;
+    std::deque<OutboundMessage> write_queue;
+    std::vector<uint64_t> channels;  // bitset indexed by channel id
+    uint32_t generation = 0;
+    uint32_t refs = 0;               // 1 while open plus one per pending async op
+    bool open = false;
+    bool writing = false;
+    bool deflate = false;            // every binary frame is raw deflate; text frames are uncompressed
+    Encoding encoding = Encoding::Json;
+
+    bool subscribed(uint32_t channel) const;
+    bool setSubscribed(uint32_t channel, bool on);
+};
+
+struct CompressionStats {
+    uint64_t messages = 0;      // payloads compressed (once per broadcast)
+    uint64_t frames_sent = 0;   // compressed frames queued to clients
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t bytes_saved = 0;   // summed over every compressed frame sent
+    uint64_t cpu_ns = 0;
+};
+
 class WebSocketServer {
 public:
-    explicit WebSocketServer(short port);
+    // replay_depth bounds the per-symbol ring of recent deltas served to
+    // clients that resume after a reconnect.
+    explicit WebSocketServer(short port, size_t replay_depth = 4096);
+    // Client subscriptions are reported to demand as references to their
+    // upstream symbol, and refused for symbols it does not know. Must be set
+    // before start().
+    void setSubscriptionDemand(SubscriptionDemand* demand);
+    // Serves {"type":"history"} requests for candle channels. Must be set before start().
+    void setCandleSource(const CandleAggregator* candles);
     void start();
     void stop();
-    void broadcastOrderbook(const std::string& symbol, const json& orderbook);
+    // Streams an update on the "{instrument}" channel: subscribers get a full
+    // snapshot when they subscribe and then only the sequenced level deltas.
+    // Deltas at or below the snapshot's sequence are already included in it.
+    // A reconnecting client sends {"type":"resume","symbol":...,"last_seq":N}
+    // and gets the deltas after N, or a snapshot if they left the replay ring.
+    // Subscribers that asked for an interval get at most one delta per
+    // interval, merging everything since the last one they were sent.
+    // "book.grouped.{instrument}.{bucket}.{levels}" carries the top levels
+    // of the book summed into price buckets, as a full "grouped" message
+    // whenever they change.
+    void broadcastOrderbook(const BookUpdate& update);
+    // Published on the "analytics.{symbol}" channel.
+    void broadcastAnalytics(const std::string& symbol, const json& analytics);
+    // Published on "bbo.{instrument}" after every book update.
+    void broadcastBbo(const std::string& instrument, uint64_t sequence, int64_t timestamp, double bid_price,
+                      double bid_amount, double ask_price, double ask_amount);
+    // Published on "trades.{instrument}", one message per batch of new trades.
+    void broadcastTrades(const std::string& instrument, const std::vector<Trade>& trades);
+    // Published on "candles.{instrument}.{timeframe}", once per change to a candle.
+    void broadcastCandle(const std::string& instrument, const std::string& timeframe, const Candle& candle);
+    CompressionStats compressionStats() const;
 
 private:
+    struct Publication;
+
+    // Depth summed into buckets of width bucket (bids round down, asks up).
+    // Maintained from the replica's level changes while it has subscribers.
+    struct Grouping {
+        struct Bucket {
+            double amount = 0.0;
+            uint32_t levels = 0;
+        };
+        uint32_t channel = 0;
+        uint32_t book_channel = 0;
+        double bucket = 0.0;
+        size_t depth = 0;
+        std::map<int64_t, Bucket, std::greater<int64_t>> bids;
+        std::map<int64_t, Bucket> asks;
+        std::vector<PriceLevel> top_bids;
+        std::vector<PriceLevel> top_asks;
+        std::shared_ptr<Publication> current;  // latest top levels, null until the book has data
+    };
+
+    // Replica book plus the last replay_depth_ deltas, slot = sequence % depth.
+    // The encoded snapshot is cached until the book's sequence moves on.
+    struct BookChannel {
+        explicit BookChannel(const std::string& instrument) : book(instrument) {}
+        OrderBook book;
+        std::vector<std::shared_ptr<Publication>> replay;
+        std::shared_ptr<const std::string> snapshots[4];  // [binary * 2 + deflate]
+        uint64_t snapshot_sequence = 0;
+        std::vector<std::unique_ptr<Grouping>> groupings;
+    };
+
+    // Conflation slot for a session subscribed to a channel with an interval.
+    // Updates only mark it dirty; it is flushed at most once per interval.
+    struct Throttle {
+        std::shared_ptr<Publication> latest;  // non-book channels: newest pending update
+        TimerWheel::Clock::time_point last_flush;
+        uint64_t sent_sequence = 0;           // book channels: last sequence delivered
+        uint32_t session = 0;
+        uint32_t channel = 0;
+        uint32_t interval_ms = 0;
+        uint32_t generation = 0;              // bumped on release so queued timers go stale
+        bool dirty = false;
+        bool scheduled = false;
+    };
+
+    struct Conflated {
+        uint32_t channel;
+        uint64_t from;
+        uint64_t to;
+        std::shared_ptr<Publication> publication;
+    };
+
+    static std::shared_ptr<Publication> deltaPublication(std::shared_ptr<const BookUpdate> update,
+                                                         uint64_t prev_sequence);
+    void broadcast(const std::string& channel, std::shared_ptr<Publication> publication);
+    void fanOut(uint32_t channel, const std::shared_ptr<Publication>& publication);
+    BookChannel& bookChannel(uint32_t channel);
+    OutboundMessage payloadFor(Publication& publication, uint32_t channel, const Session& session);
+    // cached holds the deflated copy of plain, compressed on first use.
+    OutboundMessage deflated(std::shared_ptr<const std::string>& cached, const std::shared_ptr<const std::string>& plain,
+                             bool binary);
+    void sendInstrumentDef(uint32_t index, uint32_t channel);
+    void setEncoding(uint32_t index, Encoding encoding);
+    void sendSnapshot(uint32_t index, uint32_t channel);
+    std::shared_ptr<const std::string> encodeSnapshot(uint32_t channel, Encoding encoding) const;
     void acceptConnections();
-    void handleConnection(std::shared_ptr<websocket::stream<boost::asio::ip::tcp::socket>> ws);
-    void readMessages(std::shared_ptr<websocket::stream<boost::asio::ip::tcp::socket>> ws);
-    void handleClientMessage(std::shared_ptr<websocket::stream<boost::asio::ip::tcp::socket>> ws, const std::string& message);
+    void handleConnection(uint32_t index);
+    void readMessages(uint32_t index);
+    void handleClientMessage(uint32_t index, std::string_view message);
+
+    uint32_t acquireSession();
+    void retain(uint32_t index);
+    void release(uint32_t index);
+    void closeSession(uint32_t index);
+    void send(uint32_t index, OutboundMessage message);
+    std::shared_ptr<const std::string> compress(const std::string& payload);
+    void writeNext(uint32_t index);
+
+    uint32_t channelId(std::string_view channel);
+    static std::string upstreamSymbol(std::string_view channel);
+    static bool parseCandleChannel(std::string_view channel, std::string_view& instrument,
+                                   std::string_view& timeframe);
+    static bool parseGroupedChannel(std::string_view channel, std::string_view& instrument,
+                                    double& bucket, size_t& depth);
+    bool addSubscriber(uint32_t index, uint32_t channel);
+    void removeSubscriber(uint32_t index, uint32_t channel);
+    bool acceptChannel(uint32_t index, std::string_view channel);
+    bool subscribe(uint32_t index, std::string_view channel, uint32_t interval_ms);
+    bool resume(uint32_t index, std::string_view channel, uint64_t last_seq, uint32_t interval_ms);
+    bool replay(uint32_t index, uint32_t channel, uint64_t last_seq);
+    void sendCandleHistory(uint32_t index, std::string_view channel, size_t limit);
+
+    void setThrottle(uint32_t index, uint32_t channel, uint32_t interval_ms);
+    void releaseThrottle(uint32_t id);
+    void markDirty(uint32_t id, const std::shared_ptr<Publication>& publication);
+    void flushThrottle(uint32_t id);
+    std::shared_ptr<Publication> conflate(uint32_t channel, uint64_t from);
+    void armFlushTimer();
+
+    void addGrouping(uint32_t channel);
+    void removeGrouping(uint32_t channel);
+    static void applyToGrouping(Grouping& grouping, const LevelDelta& delta, double previous_amount);
+    void publishGrouping(Grouping& grouping, const OrderBook& book);
+    void unsubscribe(uint32_t index, std::string_view channel);
 
     io_context io_context_;
     boost::asio::ip::tcp::acceptor acceptor_;
-    std::unordered_map<std::shared_ptr<websocket::stream<boost::asio::ip::tcp::socket>>, std::unordered_set<std::string>> subscriptions_;
-    std::shared_mutex mutex_;
+    std::vector<std::unique_ptr<Session>> sessions_;
+    std::vector<uint32_t> free_sessions_;
+    std::deque<std::string> channel_names_;  // owns the keys of channel_ids_
+    std::unordered_map<std::string_view, uint32_t> channel_ids_;
+    std::vector<std::vector<uint32_t>> channel_subscribers_;  // unthrottled session indices per channel id
+    std::vector<std::vector<uint32_t>> channel_throttles_;    // throttle ids per channel id
+    std::vector<Throttle> throttles_;
+    std::vector<uint32_t> free_throttles_;
+    std::unordered_map<uint64_t, uint32_t> throttle_ids_;     // session << 32 | channel
+    std::vector<Conflated> conflated_;                        // merged deltas shared within a flush pass
+    TimerWheel flush_wheel_;
+    boost::asio::steady_timer flush_timer_;
+    bool flush_armed_ = false;
+    SubscriptionDemand* demand_ = nullptr;
+    const CandleAggregator* candles_ = nullptr;
+    std::vector<std::unique_ptr<BookChannel>> books_;         // per book channel id, else null
+    size_t replay_depth_;
+    std::unordered_map<uint32_t, Grouping*> groupings_;       // by grouped channel id
+    DeflateCompressor compressor_;
+    std::atomic<uint64_t> compressed_messages_{0};
+    std::atomic<uint64_t> compressed_frames_{0};
+    std::atomic<uint64_t> compressed_bytes_in_{0};
+    std::atomic<uint64_t> compressed_bytes_out_{0};
+    std::atomic<uint64_t> compressed_bytes_saved_{0};
+    std::atomic<uint64_t> compression_ns_{0};
     bool running_ = false;
 };
 
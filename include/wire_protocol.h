@@ -0,0 +1,347 @@
+#ifndef WIRE_PROTOCOL_H
+#define WIRE_PROTOCOL_H
+
+// Compact binary encoding for WebSocket subscribers. Header-only so client
+// programs can include it without linking anything from this project.
+//
+// Every message starts with a 16 byte header and all fields are fixed-size
+// little-endian. Prices and amounts are signed 64-bit integers in units of
+// 1e-8 (kValueScale). Instruments are referred to by a numeric id that is
+// announced with an InstrumentDef message before any data for it.
+//
+//   Header        type:u16 version:u16 length:u32 sequence:u64
+//   InstrumentDef header, instrument_id:u32, symbol_length:u32, symbol[symbol_length]
+//   BookSnapshot  header, timestamp:i64, instrument_id:u32, bid_count:u16, ask_count:u16,
+//                 (price:i64 amount:i64)[bid_count + ask_count], bids first, best first;
+//                 a side deeper than kMaxSnapshotLevels is cut to its best levels
+//   BookDelta     header, timestamp:i64, instrument_id:u32, count:u32,
+//                 (price:i64 amount:i64 side:u8 pad[7])[count], amount 0 removes the level
+//   Trade         header, timestamp:i64, instrument_id:u32, direction:u8 pad[3],
+//                 trade_id:u64 price:i64 amount:i64
+//   Bbo           header, timestamp:i64, instrument_id:u32, pad[4],
+//                 bid_price:i64 bid_amount:i64 ask_price:i64 ask_amount:i64
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace wire {
+
+constexpr uint16_t kVersion = 1;
+constexpr double kValueScale = 1e8;
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kBookBodySize = 16;   // timestamp, instrument_id, counts
+constexpr size_t kLevelSize = 16;
+constexpr uint16_t kMaxSnapshotLevels = 0xffff;  // per side, bounded by the u16 counts
+constexpr size_t kDeltaLevelSize = 24;
+constexpr size_t kTradeSize = kHeaderSize + 40;
+constexpr size_t kBboSize = kHeaderSize + 48;
+
+enum class MessageType : uint16_t {
+    InstrumentDef = 1,
+    BookSnapshot = 2,
+    BookDelta = 3,
+    Trade = 4,
+    Bbo = 5
+};
+
+inline int64_t toFixed(double value) { return std::llround(value * kValueScale); }
+inline double fromFixed(int64_t value) { return static_cast<double>(value) / kValueScale; }
+
+// Byte-wise little-endian access; compilers lower these to single moves.
+inline void store16(uint8_t* p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+inline void store32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+inline void store64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+inline uint16_t load16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+inline uint32_t load32(const uint8_t* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    return v;
+}
+inline uint64_t load64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+struct Header {
+    MessageType type = MessageType::BookSnapshot;
+    uint16_t version = kVersion;
+    uint32_t length = 0;    // whole message including the header
+    uint64_t sequence = 0;
+};
+
+// ---- encoding -------------------------------------------------------------
+
+// Appends messages to a byte string; begin() reserves the header and end()
+// fills in the final length.
+class Writer {
+public:
+    explicit Writer(std::string& out) : out_(out) {}
+
+    void begin(MessageType type, uint64_t sequence) {
+        start_ = out_.size();
+        out_.resize(start_ + kHeaderSize);
+        uint8_t* p = at(start_);
+        store16(p, static_cast<uint16_t>(type));
+        store16(p + 2, kVersion);
+        store64(p + 8, sequence);
+    }
+    void end() { store32(at(start_) + 4, static_cast<uint32_t>(out_.size() - start_)); }
+
+    void u8(uint8_t v) { out_.push_back(static_cast<char>(v)); }
+    void u16(uint16_t v) { grow(2); store16(at(out_.size() - 2), v); }
+    void u32(uint32_t v) { grow(4); store32(at(out_.size() - 4), v); }
+    void u64(uint64_t v) { grow(8); store64(at(out_.size() - 8), v); }
+    void i64(int64_t v) { u64(static_cast<uint64_t>(v)); }
+    void pad(size_t n) { out_.append(n, '\0'); }
+    void bytes(std::string_view v) { out_.append(v.data(), v.size()); }
+    // Overwrites a u16/u32 written earlier at an absolute offset.
+    void patch16(size_t offset, uint16_t v) { store16(at(offset), v); }
+    void patch32(size_t offset, uint32_t v) { store32(at(offset), v); }
+    size_t size() const { return out_.size(); }
+
+private:
+    void grow(size_t n) { out_.resize(out_.size() + n); }
+    uint8_t* at(size_t offset) { return reinterpret_cast<uint8_t*>(&out_[offset]); }
+
+    std::string& out_;
+    size_t start_ = 0;
+};
+
+inline void encodeInstrumentDef(std::string& out, uint32_t instrument_id, std::string_view symbol) {
+    Writer w(out);
+    w.begin(MessageType::InstrumentDef, 0);
+    w.u32(instrument_id);
+    w.u32(static_cast<uint32_t>(symbol.size()));
+    w.bytes(symbol);
+    w.end();
+}
+
+// Bids must all be added before asks, each side best price first. Levels
+// past kMaxSnapshotLevels on a side are dropped and bid()/ask() return false.
+class SnapshotWriter {
+public:
+    SnapshotWriter(std::string& out, uint64_t sequence, int64_t timestamp, uint32_t instrument_id) : w_(out) {
+        w_.begin(MessageType::BookSnapshot, sequence);
+        w_.i64(timestamp);
+        w_.u32(instrument_id);
+        counts_ = w_.size();
+        w_.u16(0);
+        w_.u16(0);
+    }
+    bool bid(double price, double amount) { return level(bids_, price, amount); }
+    bool ask(double price, double amount) { return level(asks_, price, amount); }
+    void end() {
+        w_.patch16(counts_, bids_);
+        w_.patch16(counts_ + 2, asks_);
+        w_.end();
+    }
+
+private:
+    bool level(uint16_t& count, double price, double amount) {
+        if (count == kMaxSnapshotLevels) {
+            return false;
+        }
+        w_.i64(toFixed(price));
+        w_.i64(toFixed(amount));
+        ++count;
+        return true;
+    }
+
+    Writer w_;
+    size_t counts_ = 0;
+    uint16_t bids_ = 0;
+    uint16_t asks_ = 0;
+};
+
+class DeltaWriter {
+public:
+    DeltaWriter(std::string& out, uint64_t sequence, int64_t timestamp, uint32_t instrument_id) : w_(out) {
+        w_.begin(MessageType::BookDelta, sequence);
+        w_.i64(timestamp);
+        w_.u32(instrument_id);
+        count_offset_ = w_.size();
+        w_.u32(0);
+    }
+    void level(uint8_t side, double price, double amount) {
+        w_.i64(toFixed(price));
+        w_.i64(toFixed(amount));
+        w_.u8(side);
+        w_.pad(7);
+        ++count_;
+    }
+    void end() {
+        w_.patch32(count_offset_, count_);
+        w_.end();
+    }
+
+private:
+    Writer w_;
+    size_t count_offset_ = 0;
+    uint32_t count_ = 0;
+};
+
+inline void encodeTrade(std::string& out, uint64_t sequence, int64_t timestamp, uint32_t instrument_id,
+                        bool buy, uint64_t trade_id, double price, double amount) {
+    Writer w(out);
+    w.begin(MessageType::Trade, sequence);
+    w.i64(timestamp);
+    w.u32(instrument_id);
+    w.u8(buy ? 0 : 1);
+    w.pad(3);
+    w.u64(trade_id);
+    w.i64(toFixed(price));
+    w.i64(toFixed(amount));
+    w.end();
+}
+
+inline void encodeBbo(std::string& out, uint64_t sequence, int64_t timestamp, uint32_t instrument_id,
+                      double bid_price, double bid_amount, double ask_price, double ask_amount) {
+    Writer w(out);
+    w.begin(MessageType::Bbo, sequence);
+    w.i64(timestamp);
+    w.u32(instrument_id);
+    w.pad(4);
+    w.i64(toFixed(bid_price));
+    w.i64(toFixed(bid_amount));
+    w.i64(toFixed(ask_price));
+    w.i64(toFixed(ask_amount));
+    w.end();
+}
+
+// ---- decoding -------------------------------------------------------------
+
+struct Level {
+    double price;
+    double amount;
+    uint8_t side;  // 0 bid, 1 ask (deltas only)
+};
+
+// Zero-copy view over one message; accessors read straight from the frame.
+class MessageView {
+public:
+    MessageView() = default;
+    MessageView(const uint8_t* data, const Header& header) : data_(data), header_(header) {}
+
+    const Header& header() const { return header_; }
+    MessageType type() const { return header_.type; }
+    uint64_t sequence() const { return header_.sequence; }
+
+    int64_t timestamp() const { return static_cast<int64_t>(load64(body())); }
+    uint32_t instrumentId() const {
+        return type() == MessageType::InstrumentDef ? load32(body()) : load32(body() + 8);
+    }
+
+    // InstrumentDef
+    std::string_view symbol() const {
+        return {reinterpret_cast<const char*>(body() + 8), load32(body() + 4)};
+    }
+
+    // BookSnapshot / BookDelta
+    uint32_t bidCount() const { return type() == MessageType::BookSnapshot ? load16(body() + 12) : 0; }
+    uint32_t askCount() const { return type() == MessageType::BookSnapshot ? load16(body() + 14) : 0; }
+    uint32_t levelCount() const {
+        return type() == MessageType::BookSnapshot ? bidCount() + askCount() : load32(body() + 12);
+    }
+    Level level(uint32_t i) const {
+        if (type() == MessageType::BookSnapshot) {
+            const uint8_t* p = body() + kBookBodySize + i * kLevelSize;
+            return {fromFixed(static_cast<int64_t>(load64(p))), fromFixed(static_cast<int64_t>(load64(p + 8))),
+                    static_cast<uint8_t>(i < bidCount() ? 0 : 1)};
+        }
+        const uint8_t* p = body() + kBookBodySize + i * kDeltaLevelSize;
+        return {fromFixed(static_cast<int64_t>(load64(p))), fromFixed(static_cast<int64_t>(load64(p + 8))), p[16]};
+    }
+
+    // Trade
+    bool buy() const { return body()[12] == 0; }
+    uint64_t tradeId() const { return load64(body() + 16); }
+    double tradePrice() const { return fromFixed(static_cast<int64_t>(load64(body() + 24))); }
+    double tradeAmount() const { return fromFixed(static_cast<int64_t>(load64(body() + 32))); }
+
+    // Bbo
+    double bidPrice() const { return fromFixed(static_cast<int64_t>(load64(body() + 16))); }
+    double bidAmount() const { return fromFixed(static_cast<int64_t>(load64(body() + 24))); }
+    double askPrice() const { return fromFixed(static_cast<int64_t>(load64(body() + 32))); }
+    double askAmount() const { return fromFixed(static_cast<int64_t>(load64(body() + 40))); }
+
+private:
+    const uint8_t* body() const { return data_ + kHeaderSize; }
+
+    const uint8_t* data_ = nullptr;
+    Header header_;
+};
+
+// Validates the header and the minimum size for the message type.
+inline bool decode(const uint8_t* data, size_t size, MessageView& view) {
+    if (size < kHeaderSize) {
+        return false;
+    }
+    Header header;
+    header.type = static_cast<MessageType>(load16(data));
+    header.version = load16(data + 2);
+    header.length = load32(data + 4);
+    header.sequence = load64(data + 8);
+    if (header.version != kVersion || header.length < kHeaderSize || header.length > size) {
+        return false;
+    }
+    size_t body = header.length - kHeaderSize;
+    const uint8_t* p = data + kHeaderSize;
+    switch (header.type) {
+    case MessageType::InstrumentDef:
+        if (body < 8 || body < 8 + static_cast<size_t>(load32(p + 4))) return false;
+        break;
+    case MessageType::BookSnapshot:
+        if (body < kBookBodySize ||
+            body < kBookBodySize + (static_cast<size_t>(load16(p + 12)) + load16(p + 14)) * kLevelSize) return false;
+        break;
+    case MessageType::BookDelta:
+        if (body < kBookBodySize || body < kBookBodySize + static_cast<size_t>(load32(p + 12)) * kDeltaLevelSize) return false;
+        break;
+    case MessageType::Trade:
+        if (header.length < kTradeSize) return false;
+        break;
+    case MessageType::Bbo:
+        if (header.length < kBboSize) return false;
+        break;
+    default:
+        return false;
+    }
+    view = MessageView(data, header);
+    return true;
+}
+
+// Iterates the messages packed in one frame.
+class Reader {
+public:
+    Reader(const void* data, size_t size) : p_(static_cast<const uint8_t*>(data)), remaining_(size) {}
+
+    bool next(MessageView& view) {
+        if (!decode(p_, remaining_, view)) {
+            return false;
+        }
+        p_ += view.header().length;
+        remaining_ -= view.header().length;
+        return true;
+    }
+
+private:
+    const uint8_t* p_;
+    size_t remaining_;
+};
+
+}  // namespace wire
+
+#endif
@@ -26,6 +26,16 @@ namespace json = boost::json;
 APIHandler::APIHandler(const std::string& client_id, const std::string& client_secret)
     : client_id_(client_id), client_secret_(client_secret) {}
 
+std::string APIHandler::accessToken() const {
+    std::lock_guard<std::mutex> lock(token_mutex_);
+    return access_token_;
+}
+
+void APIHandler::setAccessToken(const std::string& token) {
+    std::lock_guard<std::mutex> lock(token_mutex_);
+    access_token_ = token;
+}
+
 bool APIHandler::authenticate() {
     Logger::log("Authenticating...");
 
@@ -53,8 +63,8 @@ bool APIHandler::authenticate() {
     }
 
     if (jsonData.isMember("result") && jsonData["result"].isMember("access_token")) {
-        access_token_ = jsonData["result"]["access_token"].asString();
-        Logger::log("Authentication successful. Access token: " + access_token_);
+        setAccessToken(jsonData["result"]["access_token"].asString());
+        Logger::log("Authentication successful. Access token: " + accessToken());
         return true;
     } else {
         Logger::log("Authentication failed: access_token not found.");
@@ -62,7 +72,8 @@ bool APIHandler::authenticate() {
     }
 }
 
-std::string APIHandler::placeOrder(const std::string& instrument, double quantity, const std::string& side) {
+std::string APIHandler::placeOrder(const std::string& instrument, double quantity, const std::string& side,
+                                   const std::string& label, double price) {
     try {
         Logger::log("Placing order...");
 
@@ -77,7 +88,15 @@ std::string APIHandler::placeOrder(const std::string& instrument, double quantit
         if (side == "sell") {
             endpoint = "https://test.deribit.com/api/v2/private/sell";
         }
-        std::string url = endpoint + "?instrument_name=" + instrument + "&amount=" + std::to_string(quantity) + "&type=market";
+        std::string url = endpoint + "?instrument_name=" + instrument + "&amount=" + std::to_string(quantity);
+        if (price > 0) {
+            url += "&type=limit&price=" + std::to_string(price);
+        } else {
+            url += "&type=market";
+        }
+        if (!label.empty()) {
+            url += "&label=" + label;
+        }
         std::string response = makeRequest(url, "");
         if (response.empty()) {
             throw std::runtime_error("Failed to place order: Empty response from server.");
@@ -91,7 +110,7 @@ std::string APIHandler::placeOrder(const std::string& instrument, double quantit
     }
 }
 
-std::string APIHandler::modifyOrder(const std::string& order_id, double quantity) {
+std::string APIHandler::modifyOrder(const std::string& order_id, double quantity, double price) {
 try {
         Logger::log("Modifying order...");
 
@@ -103,7 +122,12 @@ try {
         }
 
         std::string endpoint = "https://test.deribit.com/api/v2/private/edit";
-        std::string url = endpoint + "?advanced=implv" + "&amount=" + std::to_string(quantity) + "&order_id=" + order_id;
+        std::string url = endpoint + "?amount=" + std::to_string(quantity) + "&order_id=" + order_id;
+        if (price > 0) {
+            url += "&price=" + std::to_string(price);
+        } else {
+            url += "&advanced=implv";
+        }
         std::string response = makeRequest(url, "");
         if (response.empty()) {
             throw std::runtime_error("Failed to modify order: Empty response from server.");
@@ -117,7 +141,7 @@ try {
     }
 }
 
-bool APIHandler::cancelOrder(const std::string& order_id) {
+std::string APIHandler::cancelOrder(const std::string& order_id) {
     try {
         Logger::log("Cancelling order...");
 
@@ -134,10 +158,75 @@ bool APIHandler::cancelOrder(const std::string& order_id) {
         }
 
         Logger::log("Cancel response: " + response);
-        return true;
+        return response;
     } catch (const std::exception& e) {
         Logger::log("Error cancelling order: " + std::string(e.what()));
-        return false;
+        return "";
+    }
+}
+
+std::string APIHandler::cancelAll() {
+    try {
+        Logger::log("Cancelling all orders...");
+
+        std::string response = makeRequest("https://test.deribit.com/api/v2/private/cancel_all?detailed=true", "");
+        if (response.empty()) {
+            throw std::runtime_error("Failed to cancel all orders: Empty response from server.");
+        }
+
+        Logger::log("Cancel all response: " + response);
+        return response;
+    } catch (const std::exception& e) {
+        Logger::log("Error cancelling all orders: " + std::string(e.what()));
+        return "";
+    }
+}
+
+std::string APIHandler::cancelAllByInstrument(const std::string& instrument) {
+    try {
+        Logger::log("Cancelling all orders in " + instrument + "...");
+
+        if (instrument.empty()) {
+            throw std::invalid_argument("Instrument name is empty.");
+        }
+
+        std::string endpoint = "https://test.deribit.com/api/v2/private/cancel_all_by_instrument";
+        std::string url = endpoint + "?instrument_name=" + instrument + "&detailed=true";
+
+        std::string response = makeRequest(url, "");
+        if (response.empty()) {
+            throw std::runtime_error("Failed to cancel orders: Empty response from server.");
+        }
+
+        Logger::log("Cancel all response: " + response);
+        return response;
+    } catch (const std::exception& e) {
+        Logger::log("Error cancelling orders by instrument: " + std::string(e.what()));
+        return "";
+    }
+}
+
+std::string APIHandler::cancelAllByCurrency(const std::string& currency, const std::string& kind) {
+    try {
+        Logger::log("Cancelling all " + currency + " orders...");
+
+        if (currency.empty()) {
+            throw std::invalid_argument("Currency is empty.");
+        }
+
+        std::string endpoint = "https://test.deribit.com/api/v2/private/cancel_all_by_currency";
+        std::string url = endpoint + "?currency=" + currency + "&kind=" + kind + "&detailed=true";
+
+        std::string response = makeRequest(url, "");
+        if (response.empty()) {
+            throw std::runtime_error("Failed to cancel orders: Empty response from server.");
+        }
+
+        Logger::log("Cancel all response: " + response);
+        return response;
+    } catch (const std::exception& e) {
+        Logger::log("Error cancelling orders by currency: " + std::string(e.what()));
+        return "";
     }
 }
 
@@ -164,6 +253,107 @@ std::string APIHandler::getOrderBook(const std::string& instrument) {
     }
 }
 
+std::string APIHandler::getInstruments(const std::string& currency, const std::string& kind) {
+    try {
+        Logger::log("Fetching " + currency + " instruments...");
+
+        std::string endpoint = "https://test.deribit.com/api/v2/public/get_instruments";
+        std::string url = endpoint + "?currency=" + currency + "&kind=" + kind + "&expired=false";
+
+        std::string response = makeRequest(url, "");
+        if (response.empty()) {
+            throw std::runtime_error("Failed to fetch instruments: Empty response from server.");
+        }
+        return response;
+    } catch (const std::exception& e) {
+        Logger::log("Error fetching instruments: " + std::string(e.what()));
+        return "";
+    }
+}
+
+std::string APIHandler::getLastTrades(const std::string& instrument, uint64_t start_seq, int count) {
+    try {
+        Logger::log("Fetching last trades...");
+
+        if (instrument.empty()) {
+            throw std::invalid_argument("Instrument name is empty.");
+        }
+
+        std::string endpoint = "https://test.deribit.com/api/v2/public/get_last_trades_by_instrument?instrument_name=" +
+                               instrument + "&count=" + std::to_string(count) + "&sorting=asc";
+        if (start_seq != 0) {
+            endpoint += "&start_seq=" + std::to_string(start_seq);
+        }
+
+        std::string response = makeRequest(endpoint, "");
+        if (response.empty()) {
+            throw std::runtime_error("Failed to fetch trades: Empty response from server.");
+        }
+        return response;
+    } catch (const std::exception& e) {
+        Logger::log("Error fetching trades: " + std::string(e.what()));
+        return "";
+    }
+}
+
+std::string APIHandler::getOpenOrders(const std::string& currency, const std::string& kind) {
+    try {
+        Logger::log("Fetching open " + currency + " orders...");
+
+        std::string endpoint = "https://test.deribit.com/api/v2/private/get_open_orders_by_currency";
+        std::string url = endpoint + "?currency=" + currency + "&kind=" + kind;
+
+        std::string response = makeRequest(url, "");
+        if (response.empty()) {
+            throw std::runtime_error("Failed to fetch open orders: Empty response from server.");
+        }
+        return response;
+    } catch (const std::exception& e) {
+        Logger::log("Error fetching open orders: " + std::string(e.what()));
+        return "";
+    }
+}
+
+std::string APIHandler::getOrderState(const std::string& order_id) {
+    try {
+        if (order_id.empty()) {
+            throw std::invalid_argument("Order ID is empty.");
+        }
+
+        std::string endpoint = "https://test.deribit.com/api/v2/private/get_order_state";
+        std::string url = endpoint + "?order_id=" + order_id;
+
+        std::string response = makeRequest(url, "");
+        if (response.empty()) {
+            throw std::runtime_error("Failed to fetch order state: Empty response from server.");
+        }
+        return response;
+    } catch (const std::exception& e) {
+        Logger::log("Error fetching order state: " + std::string(e.what()));
+        return "";
+    }
+}
+
+std::string APIHandler::getOrderStateByLabel(const std::string& currency, const std::string& label) {
+    try {
+        if (label.empty()) {
+            throw std::invalid_argument("Label is empty.");
+        }
+
+        std::string endpoint = "https://test.deribit.com/api/v2/private/get_order_state_by_label";
+        std::string url = endpoint + "?currency=" + currency + "&label=" + label;
+
+        std::string response = makeRequest(url, "");
+        if (response.empty()) {
+            throw std::runtime_error("Failed to fetch order state: Empty response from server.");
+        }
+        return response;
+    } catch (const std::exception& e) {
+        Logger::log("Error fetching order state by label: " + std::string(e.what()));
+        return "";
+    }
+}
+
 std::string APIHandler::getPositions(const std::string& currency, std::string kind) {
     try {
         Logger::log("Fetching positions...");
@@ -171,7 +361,7 @@ std::string APIHandler::getPositions(const std::string& currency, std::string ki
         std::string endpoint = "https://test.deribit.com/api/v2/private/get_positions";
         std::string url = endpoint + "?currency=" + currency + "&kind=" + kind;
 
-        std::string response = makeRequest(endpoint, "");
+        std::string response = makeRequest(url, "");
         if (response.empty()) {
             throw std::runtime_error("Failed to fetch positions: Empty response from server.");
         }
@@ -215,8 +405,9 @@ std::string APIHandler::makeRequest(const std::string& endpoint, const std::stri
         req.set(http::field::content_type, "application/json");
         req.set(http::field::accept, "*/*");
 
-        if (!access_token_.empty()) {
-            req.set(http::field::authorization, "Bearer " + access_token_);
+        std::string access_token = accessToken();
+        if (!access_token.empty()) {
+            req.set(http::field::authorization, "Bearer " + access_token);
         }
 
         // Send the HTTP request
@@ -250,8 +441,8 @@ std::string APIHandler::makeRequest(const std::string& endpoint, const std::stri
             /* code */
         json::value jsonData = json::parse(responseBody);
         if (jsonData.as_object().contains("result") && jsonData.at("result").as_object().contains("access_token")) {
-            access_token_ = jsonData.at("result").as_object().at("access_token").as_string();
-            Logger::log("Access token obtained: " + access_token_);
+            setAccessToken(std::string(jsonData.at("result").as_object().at("access_token").as_string()));
+            Logger::log("Access token obtained: " + accessToken());
         }
         }
         catch(const std::exception& e)
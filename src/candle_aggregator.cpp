@@ -0,0 +1,176 @@
+#include "candle_aggregator.h"
+#include "logger.h"
+#include <algorithm>
+
+nlohmann::json toJson(const Candle& candle) {
+    return {
+        {"start", candle.start},
+        {"open", candle.open},
+        {"high", candle.high},
+        {"low", candle.low},
+        {"close", candle.close},
+        {"volume", candle.volume},
+        {"trades", candle.trades}
+    };
+}
+
+CandleAggregator::CandleAggregator(std::vector<std::string> timeframes, size_t history)
+    : history_(std::max<size_t>(history, 1)) {
+    for (auto& timeframe : timeframes) {
+        int64_t period = parseTimeframe(timeframe);
+        if (period == 0) {
+            Logger::log("Ignoring unknown candle timeframe: " + timeframe);
+            continue;
+        }
+        timeframes_.push_back(std::move(timeframe));
+        periods_.push_back(period);
+    }
+}
+
+int64_t CandleAggregator::parseTimeframe(std::string_view timeframe) {
+    if (timeframe.size() < 2) {
+        return 0;
+    }
+    int64_t count = 0;
+    for (char c : timeframe.substr(0, timeframe.size() - 1)) {
+        if (c < '0' || c > '9' || count > 1000000) {
+            return 0;
+        }
+        count = count * 10 + (c - '0');
+    }
+    switch (timeframe.back()) {
+    case 's': return count * 1000;
+    case 'm': return count * 60 * 1000;
+    case 'h': return count * 60 * 60 * 1000;
+    case 'd': return count * 24 * 60 * 60 * 1000;
+    default: return 0;
+    }
+}
+
+bool CandleAggregator::hasTimeframe(std::string_view timeframe) const {
+    return std::find(timeframes_.begin(), timeframes_.end(), timeframe) != timeframes_.end();
+}
+
+CandleAggregator::Entry& CandleAggregator::entry(const std::string& instrument) {
+    {
+        std::shared_lock lock(mutex_);
+        auto it = entries_.find(instrument);
+        if (it != entries_.end()) {
+            return *it->second;
+        }
+    }
+    std::unique_lock lock(mutex_);
+    auto& slot = entries_[instrument];
+    if (!slot) {
+        slot = std::make_unique<Entry>();
+        slot->series.resize(timeframes_.size());
+        for (auto& series : slot->series) {
+            series.ring.resize(history_);
+        }
+    }
+    return *slot;
+}
+
+const CandleAggregator::Entry* CandleAggregator::find(const std::string& instrument) const {
+    std::shared_lock lock(mutex_);
+    auto it = entries_.find(instrument);
+    return it == entries_.end() ? nullptr : it->second.get();
+}
+
+bool CandleAggregator::apply(Series& series, int64_t period, const Trade& trade, int64_t& start) {
+    start = trade.timestamp - ((trade.timestamp % period) + period) % period;
+    size_t size = series.ring.size();
+    if (series.count == 0 || start > series.ring[series.head].start) {
+        series.head = series.count == 0 ? 0 : (series.head + 1) % size;
+        series.count = std::min(series.count + 1, size);
+        Candle& candle = series.ring[series.head];
+        candle = Candle{};
+        candle.start = start;
+        candle.open = candle.high = candle.low = candle.close = trade.price;
+        candle.volume = trade.amount;
+        candle.trades = 1;
+        return true;
+    }
+    // Late trades normally belong to the open candle; older ones are looked
+    // up by walking back, which stops at the first candle that is older still.
+    for (size_t back = 0; back < series.count; ++back) {
+        Candle& candle = series.ring[(series.head + size - back) % size];
+        if (candle.start < start) {
+            break;
+        }
+        if (candle.start == start) {
+            candle.high = std::max(candle.high, trade.price);
+            candle.low = std::min(candle.low, trade.price);
+            if (back == 0) {
+                candle.close = trade.price;
+            }
+            candle.volume += trade.amount;
+            ++candle.trades;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CandleAggregator::onTrades(const std::string& instrument, const TradeRing& ring, uint64_t first, uint64_t end) {
+    if (first >= end || timeframes_.empty()) {
+        return;
+    }
+    Entry& candle_entry = entry(instrument);
+    std::vector<std::vector<Candle>> touched(timeframes_.size());
+    {
+        std::lock_guard lock(candle_entry.mutex);
+        std::vector<int64_t> oldest(timeframes_.size(), INT64_MAX);
+        ring.forEach(first, end, [&](const Trade& trade) {
+            for (size_t tf = 0; tf < timeframes_.size(); ++tf) {
+                int64_t start;
+                if (apply(candle_entry.series[tf], periods_[tf], trade, start)) {
+                    oldest[tf] = std::min(oldest[tf], start);
+                }
+            }
+        });
+        for (size_t tf = 0; tf < timeframes_.size(); ++tf) {
+            Series& series = candle_entry.series[tf];
+            size_t size = series.ring.size();
+            size_t depth = 0;
+            while (depth < series.count && series.ring[(series.head + size - depth) % size].start >= oldest[tf]) {
+                ++depth;
+            }
+            for (size_t back = depth; back-- > 0;) {
+                touched[tf].push_back(series.ring[(series.head + size - back) % size]);
+            }
+        }
+    }
+    std::shared_lock lock(mutex_);
+    for (size_t tf = 0; tf < timeframes_.size(); ++tf) {
+        for (const auto& candle : touched[tf]) {
+            for (const auto& listener : listeners_) {
+                listener(instrument, timeframes_[tf], candle);
+            }
+        }
+    }
+}
+
+std::vector<Candle> CandleAggregator::history(const std::string& instrument, std::string_view timeframe,
+                                              size_t limit) const {
+    std::vector<Candle> candles;
+    auto tf = std::find(timeframes_.begin(), timeframes_.end(), timeframe);
+    const Entry* candle_entry = find(instrument);
+    if (tf == timeframes_.end() || !candle_entry) {
+        return candles;
+    }
+    std::lock_guard lock(candle_entry->mutex);
+    const Series& series = candle_entry->series[tf - timeframes_.begin()];
+    size_t size = series.ring.size();
+    size_t n = std::min(limit, series.count);
+    candles.reserve(n);
+    for (size_t back = n; back-- > 0;) {
+        candles.push_back(series.ring[(series.head + size - back) % size]);
+    }
+    return candles;
+}
+
+void CandleAggregator::addListener(CandleListener listener) {
+    std::unique_lock lock(mutex_);
+    listeners_.push_back(std::move(listener));
+}
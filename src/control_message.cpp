@@ -0,0 +1,156 @@
+#include "control_message.h"
+#include <algorithm>
+
+namespace {
+
+class Cursor {
+public:
+    explicit Cursor(std::string_view text) : text_(text) {}
+
+    void skipSpace() {
+        while (pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\t' ||
+                                       text_[pos_] == '\n' || text_[pos_] == '\r')) {
+            ++pos_;
+        }
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek(char c) {
+        skipSpace();
+        return pos_ < text_.size() && text_[pos_] == c;
+    }
+
+    bool atEnd() {
+        skipSpace();
+        return pos_ == text_.size();
+    }
+
+    bool string(std::string_view& out) {
+        if (!consume('"')) {
+            return false;
+        }
+        size_t start = pos_;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            if (text_[pos_] == '\\') {
+                return false;
+            }
+            ++pos_;
+        }
+        if (pos_ == text_.size()) {
+            return false;
+        }
+        out = text_.substr(start, pos_ - start);
+        ++pos_;
+        return true;
+    }
+
+    // Numbers, true, false and null are returned as their raw token.
+    bool scalar(std::string_view& out) {
+        skipSpace();
+        size_t start = pos_;
+        while (pos_ < text_.size() && text_[pos_] != ',' && text_[pos_] != '}' &&
+               text_[pos_] != ' ' && text_[pos_] != '\t' && text_[pos_] != '\n' && text_[pos_] != '\r') {
+            ++pos_;
+        }
+        out = text_.substr(start, pos_ - start);
+        return !out.empty();
+    }
+
+private:
+    std::string_view text_;
+    size_t pos_ = 0;
+};
+
+ControlType toControlType(std::string_view value) {
+    if (value == "subscribe") {
+        return ControlType::Subscribe;
+    }
+    if (value == "unsubscribe") {
+        return ControlType::Unsubscribe;
+    }
+    if (value == "compression") {
+        return ControlType::Compression;
+    }
+    if (value == "snapshot") {
+        return ControlType::Snapshot;
+    }
+    if (value == "resume") {
+        return ControlType::Resume;
+    }
+    if (value == "history") {
+        return ControlType::History;
+    }
+    return ControlType::Unknown;
+}
+
+bool toUnsigned(std::string_view value, uint64_t& out) {
+    out = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9' || out > (UINT64_MAX - 9) / 10) {
+            return false;
+        }
+        out = out * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return true;
+}
+
+}  // namespace
+
+bool parseControlMessage(std::string_view text, ControlMessage& message) {
+    message = ControlMessage{};
+    Cursor cursor(text);
+    if (!cursor.consume('{')) {
+        return false;
+    }
+    if (!cursor.consume('}')) {
+        do {
+            std::string_view key;
+            std::string_view value;
+            if (!cursor.string(key) || !cursor.consume(':')) {
+                return false;
+            }
+            bool quoted = cursor.peek('"');
+            if (quoted ? !cursor.string(value) : !cursor.scalar(value)) {
+                return false;
+            }
+            if (key == "type" && quoted) {
+                message.type = toControlType(value);
+            } else if (key == "symbol" && quoted) {
+                message.symbol = value;
+            } else if (key == "mode" && quoted) {
+                message.mode = value;
+            } else if (key == "encoding" && quoted) {
+                message.encoding = value;
+            } else if (key == "last_seq" && !quoted && !toUnsigned(value, message.last_seq)) {
+                return false;
+            } else if (key == "limit" && !quoted) {
+                uint64_t number = 0;
+                if (!toUnsigned(value, number)) {
+                    return false;
+                }
+                message.limit = static_cast<uint32_t>(std::min<uint64_t>(number, UINT32_MAX));
+            } else if ((key == "interval_ms" || key == "max_rate") && !quoted) {
+                uint64_t number = 0;
+                if (!toUnsigned(value, number)) {
+                    return false;
+                }
+                if (key == "max_rate") {
+                    number = number == 0 ? 0 : std::max<uint64_t>(1000 / number, 1);
+                }
+                message.interval_ms = static_cast<uint32_t>(std::min<uint64_t>(number, UINT32_MAX));
+            }
+        } while (cursor.consume(','));
+        if (!cursor.consume('}')) {
+            return false;
+        }
+    }
+    return cursor.atEnd();
+}
@@ -0,0 +1,37 @@
+#include "deflate_compressor.h"
+#include "logger.h"
+
+namespace zlib = boost::beast::zlib;
+
+DeflateCompressor::DeflateCompressor(int level, int window_bits, int mem_level)
+    : level_(level), window_bits_(window_bits), mem_level_(mem_level) {
+    stream_.reset(level_, window_bits_, mem_level_, zlib::Strategy::normal);
+}
+
+bool DeflateCompressor::compress(std::string_view input, std::string& output) {
+    // Keeps the internal buffers; only the sliding window is discarded.
+    stream_.reset();
+
+    output.resize(stream_.upper_bound(input.size()) + 8);
+    zlib::z_params zs;
+    zs.next_in = input.data();
+    zs.avail_in = input.size();
+    zs.next_out = &output[0];
+    zs.avail_out = output.size();
+
+    boost::system::error_code ec;
+    stream_.write(zs, zlib::Flush::sync, ec);
+    if (ec && ec != zlib::error::need_buffers) {
+        Logger::log("Deflate failed: " + ec.message());
+        return false;
+    }
+    if (zs.avail_in != 0) {
+        Logger::log("Deflate failed: output buffer too small.");
+        return false;
+    }
+    output.resize(zs.total_out);
+    if (output.size() >= 4 && output.compare(output.size() - 4, 4, std::string("\x00\x00\xff\xff", 4)) == 0) {
+        output.resize(output.size() - 4);
+    }
+    return true;
+}
@@ -0,0 +1,388 @@
+#include "execution_scheduler.h"
+#include "logger.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kEpsilon = 1e-9;
+
+using Clock = TimerWheel::Clock;
+
+}  // namespace
+
+const char* toString(AlgoType type) {
+    switch (type) {
+    case AlgoType::Twap: return "twap";
+    case AlgoType::Iceberg: return "iceberg";
+    case AlgoType::Pov: return "pov";
+    }
+    return "unknown";
+}
+
+ExecutionScheduler::ExecutionScheduler(OrderManager& orders, std::chrono::milliseconds tick, size_t slots)
+    : orders_(orders), wheel_(tick, slots) {
+    orders_.addFillListener([this](const OrderRecord& order, double quantity, double) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string id(order.exchangeId());
+        auto child = child_parents_.find(id);
+        if (child != child_parents_.end()) {
+            applyFill(child->second, id, quantity);
+        } else if (placing_) {
+            unmatched_fills_[id] += quantity;
+        }
+    });
+}
+
+ExecutionScheduler::~ExecutionScheduler() {
+    stop();
+}
+
+void ExecutionScheduler::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+    thread_ = std::thread(&ExecutionScheduler::run, this);
+}
+
+void ExecutionScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        running_ = false;
+    }
+    wait_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+uint64_t ExecutionScheduler::submit(const AlgoParams& params) {
+    bool valid = !params.instrument.empty() && params.quantity > 0.0 && params.interval.count() > 0;
+    switch (params.type) {
+    case AlgoType::Twap:
+        valid = valid && params.duration.count() > 0;
+        break;
+    case AlgoType::Iceberg:
+        valid = valid && params.limit_price > 0.0 && params.display > 0.0;
+        break;
+    case AlgoType::Pov:
+        valid = valid && params.participation > 0.0 && params.participation <= 1.0;
+        break;
+    }
+    if (!valid) {
+        Logger::log("Rejecting " + std::string(toString(params.type)) + " order for " + params.instrument +
+                    ": invalid parameters.");
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t id = next_parent_++;
+    Parent& parent = parents_[id];
+    parent.params = params;
+    parent.start = Clock::now();
+    parent.start_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    ++active_;
+    schedule(id, parent, parent.start);
+    Logger::log("Started " + std::string(toString(params.type)) + " order " + std::to_string(id) + " for " +
+                std::to_string(params.quantity) + " " + params.instrument);
+    return id;
+}
+
+bool ExecutionScheduler::cancel(uint64_t id) {
+    std::string child;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = parents_.find(id);
+        if (it == parents_.end() || it->second.done) {
+            return false;
+        }
+        child = it->second.child;
+        it->second.cancelled = true;
+        finish(it->second);
+    }
+    if (!child.empty()) {
+        orders_.cancelOrder(child);
+    }
+    return true;
+}
+
+bool ExecutionScheduler::getStatus(uint64_t id, AlgoStatus& status) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = parents_.find(id);
+    if (it == parents_.end()) {
+        return false;
+    }
+    const Parent& parent = it->second;
+    status.params = parent.params;
+    status.filled = parent.filled;
+    status.working = parent.child.empty() ? 0.0 : std::max(parent.child_quantity - parent.child_filled, 0.0);
+    status.done = parent.done;
+    status.cancelled = parent.cancelled;
+    return true;
+}
+
+size_t ExecutionScheduler::active() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return active_;
+}
+
+size_t ExecutionScheduler::purgeFinished() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t purged = 0;
+    for (auto it = parents_.begin(); it != parents_.end();) {
+        if (!it->second.done) {
+            ++it;
+            continue;
+        }
+        for (const auto& child : it->second.children) {
+            child_parents_.erase(child);
+        }
+        it = parents_.erase(it);
+        ++purged;
+    }
+    return purged;
+}
+
+void ExecutionScheduler::onBook(const std::string& instrument, double bid, double ask) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Market& market = markets_[instrument];
+    market.bid = bid;
+    market.ask = ask;
+}
+
+void ExecutionScheduler::setTradeTape(const TradeTape* tape) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tape_ = tape;
+}
+
+// Each schedule supersedes the parent's earlier timers, so a parent is
+// evaluated at most once per tick however it was woken.
+void ExecutionScheduler::schedule(uint64_t id, Parent& parent, Clock::time_point when) {
+    ++parent.generation;
+    wheel_.schedule(when, uint64_t{parent.generation} << 32 | id);
+}
+
+void ExecutionScheduler::applyFill(uint64_t id, const std::string& child, double quantity) {
+    auto it = parents_.find(id);
+    if (it == parents_.end()) {
+        return;
+    }
+    Parent& parent = it->second;
+    parent.filled += quantity;
+    if (parent.child == child) {
+        parent.child_filled += quantity;
+    }
+    bool child_filled = parent.child == child && parent.child_filled >= parent.child_quantity - kEpsilon;
+    if (!parent.done && (child_filled || parent.filled >= parent.params.quantity - kEpsilon)) {
+        schedule(id, parent, Clock::now());
+    }
+}
+
+void ExecutionScheduler::finish(Parent& parent) {
+    if (!parent.done) {
+        parent.done = true;
+        ++parent.generation;
+        --active_;
+    }
+}
+
+double ExecutionScheduler::roundLot(const Parent& parent, double quantity) const {
+    if (parent.params.lot_size <= 0.0) {
+        return quantity > kEpsilon ? quantity : 0.0;
+    }
+    return std::floor(quantity / parent.params.lot_size + kEpsilon) * parent.params.lot_size;
+}
+
+// Marketable at the touch when the touch is inside the limit, otherwise
+// resting at the limit; 0 (market) without one.
+double ExecutionScheduler::childPrice(const Parent& parent) const {
+    double limit = parent.params.limit_price;
+    if (limit <= 0.0) {
+        return 0.0;
+    }
+    auto market = markets_.find(parent.params.instrument);
+    if (market == markets_.end()) {
+        return limit;
+    }
+    if (parent.params.side == Side::Bid) {
+        return market->second.ask > 0.0 ? std::min(limit, market->second.ask) : limit;
+    }
+    return market->second.bid > 0.0 ? std::max(limit, market->second.bid) : limit;
+}
+
+void ExecutionScheduler::run() {
+    std::vector<uint64_t> due;
+    std::vector<Action> actions;
+    auto next = Clock::now();
+    while (running_) {
+        next += wheel_.tick();
+        {
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            if (wait_cv_.wait_until(lock, next, [this] { return !running_; })) {
+                break;
+            }
+        }
+        auto now = Clock::now();
+        if (now - next > wheel_.tick()) {
+            next = now;  // a slow batch; fire what is due without spinning through missed ticks
+        }
+
+        due.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wheel_.advance(now, [&due](uint64_t timer) { due.push_back(timer); });
+        }
+
+        // Child orders are looked up before taking our lock: fill listeners
+        // take it while holding the order cache's.
+        actions.clear();
+        for (uint64_t timer : due) {
+            uint64_t id = timer & 0xffffffffULL;
+            auto generation = static_cast<uint32_t>(timer >> 32);
+            std::string child;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = parents_.find(id);
+                if (it == parents_.end() || it->second.generation != generation || it->second.done) {
+                    continue;
+                }
+                child = it->second.child;
+            }
+            OrderRecord record;
+            bool child_ended = !child.empty() && (!orders_.getOrder(child, record) || isTerminal(record.state));
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = parents_.find(id);
+            if (it == parents_.end() || it->second.generation != generation || it->second.done) {
+                continue;
+            }
+            evaluate(id, it->second, child_ended && it->second.child == child, now, actions);
+        }
+        if (!actions.empty()) {
+            execute(actions);
+        }
+    }
+}
+
+void ExecutionScheduler::evaluate(uint64_t id, Parent& parent, bool child_ended, Clock::time_point now,
+                                  std::vector<Action>& actions) {
+    const AlgoParams& params = parent.params;
+    double working = parent.child.empty() ? 0.0 : parent.child_quantity - parent.child_filled;
+    if (child_ended || working <= kEpsilon) {
+        parent.child.clear();
+        parent.cancelling = false;
+        working = 0.0;
+    }
+    double remaining = params.quantity - parent.filled;
+    if (working == 0.0 && roundLot(parent, remaining) <= 0.0) {
+        finish(parent);
+        Logger::log("Finished " + std::string(toString(params.type)) + " order " + std::to_string(id) + ": filled " +
+                    std::to_string(parent.filled) + " of " + std::to_string(params.quantity));
+        return;
+    }
+
+    Action action;
+    action.parent = id;
+    double target = 0.0;
+    switch (params.type) {
+    case AlgoType::Twap: {
+        // Slices are sent at the start of their interval; an unfilled
+        // remainder of the last one is cancelled and rolled into the next.
+        // That slice is sized only once the old child is terminal, so a fill
+        // racing the cancel is counted before it and never twice. A cancel
+        // that did not take is retried an interval later.
+        if (working > 0.0) {
+            action.cancel_id = parent.child;
+            actions.push_back(std::move(action));
+            schedule(id, parent, parent.cancelling ? now + params.interval : now + wheel_.tick());
+            parent.cancelling = true;
+            return;
+        }
+        double elapsed = std::chrono::duration<double>(now - parent.start + params.interval).count();
+        double fraction = std::min(1.0, elapsed / std::chrono::duration<double>(params.duration).count());
+        target = params.quantity * fraction;
+        break;
+    }
+    case AlgoType::Iceberg:
+        target = working > 0.0 ? 0.0 : parent.filled + std::min(params.display, remaining);
+        break;
+    case AlgoType::Pov: {
+        if (!parent.trades && tape_) {
+            parent.trades = tape_->find(params.instrument);
+        }
+        double volume = parent.trades ? parent.trades->volumeSince(parent.start_ms) : 0.0;
+        target = working > 0.0 ? 0.0 : params.participation * volume;
+        break;
+    }
+    }
+
+    double quantity = std::min(roundLot(parent, target - parent.filled), roundLot(parent, remaining));
+    if (quantity > 0.0) {
+        action.place = {params.instrument, quantity, params.side == Side::Bid ? "buy" : "sell", childPrice(parent)};
+    }
+    if (!action.cancel_id.empty() || action.place.quantity > 0.0) {
+        actions.push_back(std::move(action));
+    }
+    schedule(id, parent, now + params.interval);
+}
+
+// Cancels first, then every child due this tick as one concurrent batch.
+// Fills can arrive before placeOrders returns a child's id; they are held
+// by id until the child is matched to its parent below.
+void ExecutionScheduler::execute(std::vector<Action>& actions) {
+    std::vector<std::string> cancels;
+    std::vector<OrderRequest> places;
+    std::vector<uint64_t> owners;
+    for (auto& action : actions) {
+        if (!action.cancel_id.empty()) {
+            cancels.push_back(std::move(action.cancel_id));
+        }
+        if (action.place.quantity > 0.0) {
+            places.push_back(std::move(action.place));
+            owners.push_back(action.parent);
+        }
+    }
+    if (!cancels.empty()) {
+        orders_.cancelOrders(cancels);
+    }
+    if (places.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        placing_ = true;
+    }
+    BatchResult result = orders_.placeOrders(places);
+    std::vector<std::string> orphans;  // children of parents cancelled while they were being placed
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < places.size(); ++i) {
+            const std::string& child = result.order_ids[i];
+            auto it = parents_.find(owners[i]);
+            if (child.empty() || it == parents_.end()) {
+                continue;  // retried on the parent's next evaluation
+            }
+            Parent& parent = it->second;
+            child_parents_[child] = owners[i];
+            parent.children.push_back(child);
+            if (parent.done) {
+                orphans.push_back(child);
+                continue;
+            }
+            parent.child = child;
+            parent.child_quantity = places[i].quantity;
+            parent.child_filled = 0.0;
+            auto early = unmatched_fills_.find(child);
+            if (early != unmatched_fills_.end()) {
+                applyFill(owners[i], child, early->second);
+            }
+        }
+        unmatched_fills_.clear();
+        placing_ = false;
+    }
+    if (!orphans.empty()) {
+        orders_.cancelOrders(orphans);
+    }
+}
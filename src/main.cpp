@@ -3,9 +3,22 @@
 #include "order_manager.h"
 #include "logger.h"
 #include "config.h"
+#include "tick_store.h"
+#include "market_data.h"
+#include "option_pricing_engine.h"
+#include "subscription_demand.h"
+#include "candle_aggregator.h"
+#include "trade_tape.h"
+#include "risk_engine.h"
+#include "position_keeper.h"
+#include "user_stream.h"
+#include "execution_scheduler.h"
+#include "order_journal.h"
 #include <iostream>
 #include <thread>
+#include <atomic>
 #include <exception>
+#include <unordered_map>
 
 int main() {
     Logger::log("Starting Deribit Order System...");
@@ -26,8 +39,118 @@ int main() {
     // Initialize OrderManager with the API handler
     OrderManager order_manager(api_handler);
 
+    // Pre-trade limits checked before any order or amend is sent. Perpetual
+    // amounts are USD contracts, so sizes and positions are limited directly.
+    RiskEngine risk_engine(20);
+    RiskLimits perpetual_limits;
+    perpetual_limits.max_order_size = 10000;
+    perpetual_limits.max_position = 50000;
+    perpetual_limits.price_band = 0.02;
+    perpetual_limits.max_open_orders = 50;
+    perpetual_limits.max_orders_per_second = 10;
+    risk_engine.addInstrument("BTC-PERPETUAL", "BTC", perpetual_limits);
+    order_manager.setRiskEngine(&risk_engine);
+
+    // Orders open when we last stopped are rebuilt from the journal, then
+    // brought up to date with the exchange before anything new is sent
+    OrderJournal journal;
+    std::vector<OrderRecord> recovered;
+    if (journal.open("data/orders.journal", recovered)) {
+        order_manager.setJournal(&journal);
+        order_manager.restore(recovered);
+    } else {
+        Logger::log("Order journal unavailable; running without it.");
+    }
+    order_manager.reconcileOpenOrders("BTC");
+
+    // Positions and PnL kept locally from our fills and mark ticks, seeded
+    // from the exchange and reconciled against it in the background
+    PositionKeeper positions;
+    if (positions.load(order_manager.getPosition("BTC", "future"))) {
+        Position perpetual;
+        if (positions.getPosition("BTC-PERPETUAL", perpetual)) {
+            risk_engine.setPosition(risk_engine.find("BTC-PERPETUAL"), perpetual.size);
+        }
+    }
+    // Option contracts held, repriced on every underlying tick
+    OptionPricingEngine option_engine;
+    option_engine.loadPositions(order_manager.getPosition("BTC", "option"));
+
+    order_manager.addFillListener([&](const OrderRecord& order, double quantity, double price) {
+        std::string instrument(order.instrumentName());
+        positions.onFill(instrument, order.side, quantity, price);
+        option_engine.onFill(instrument, order.side == Side::Bid ? quantity : -quantity);
+    });
+
+    // Our orders, trades and positions pushed over the private user channels
+    UserStream user_stream(Config::getClientId(), Config::getClientSecret(), order_manager, &positions);
+    user_stream.addTradeListener([](const Json::Value& trade) {
+        Logger::log("Trade " + trade.get("instrument_name", "").asString() + " " +
+                    trade.get("direction", "").asString() + " " + std::to_string(trade.get("amount", 0.0).asDouble()) +
+                    " @ " + std::to_string(trade.get("price", 0.0).asDouble()));
+    });
+    user_stream.addPositionListener([&option_engine](const Json::Value& position) {
+        if (position.get("kind", "").asString() == "option") {
+            option_engine.setPosition(position.get("instrument_name", "").asString(),
+                                      position.get("size", 0.0).asDouble());
+        }
+    });
+    user_stream.setCancelOnDisconnect(true);
+    user_stream.start();
+
+    // TWAP, iceberg and POV parents worked as child orders off local market data
+    ExecutionScheduler scheduler(order_manager);
+    scheduler.start();
+
+    // Instruments are fetched only while someone needs them: WebSocket
+    // clients, plus the option engine's underlying and contracts which are always held.
+    SubscriptionDemand demand(std::chrono::seconds(30));
+    // Only listed instruments can be subscribed to; an empty reply keeps the last list.
+    auto loadUniverse = [&api_handler, &demand]() {
+        std::vector<std::string> symbols;
+        for (const char* currency : {"BTC", "ETH"}) {
+            json instruments = json::parse(api_handler.getInstruments(currency), nullptr, false);
+            if (instruments.is_discarded() || !instruments.contains("result") || !instruments["result"].is_array()) {
+                continue;
+            }
+            for (const auto& instrument : instruments["result"]) {
+                if (instrument.contains("instrument_name")) {
+                    symbols.push_back(instrument["instrument_name"].get<std::string>());
+                }
+            }
+        }
+        if (symbols.empty()) {
+            Logger::log("Failed to load the instrument list.");
+            return false;
+        }
+        demand.setUniverse(symbols);
+        return true;
+    };
+    if (!loadUniverse()) {
+        demand.setUniverse({"BTC-PERPETUAL"});
+    }
+
+    // Trade cursor per polled instrument. Stops are reported from active(),
+    // which only the orderbook thread calls, so only that thread touches it.
+    std::unordered_map<std::string, uint64_t> last_trade_seq;
+    demand.setListener([&last_trade_seq](const std::string& symbol, bool active) {
+        if (!active) {
+            last_trade_seq.erase(symbol);
+        }
+    });
+    demand.acquire("BTC-PERPETUAL");
+
+    // Recent trades per instrument, readable from any thread; POV volume is read from it
+    TradeTape trade_tape;
+    scheduler.setTradeTape(&trade_tape);
+
+    // 1s/1m/5m/1h candles from the trade tape, served on "candles.{instrument}.{timeframe}"
+    CandleAggregator candles;
+
     // Start WebSocket server in a separate thread
     WebSocketServer ws_server(8080);
+    ws_server.setSubscriptionDemand(&demand);
+    ws_server.setCandleSource(&candles);
     std::thread ws_thread([&ws_server]() {
         try {
             ws_server.start();
@@ -36,13 +159,77 @@ int main() {
         }
     });
 
-    // Fetch order book data and broadcast to WebSocket clients in a separate thread
+    // Captured order book levels for offline research queries
+    TickStore tick_store;
+    std::atomic<bool> running{true};
+
+    // In-memory books with incremental analytics, published on "analytics.{symbol}"
+    MarketData market_data;
+    market_data.setTradeTape(&trade_tape);
+
+    // Quotes of the option contracts held drive implied vol, so every one is polled
+    auto holdContract = [&demand](const std::string& instrument) {
+        if (!demand.acquire(instrument)) {
+            Logger::log("Option contract is not listed, its book is not fetched: " + instrument);
+        }
+    };
+    // Fills may already be adding contracts, so the listener goes first
+    option_engine.setContractListener(holdContract);
+    for (const auto& instrument : option_engine.instruments()) {
+        holdContract(instrument);
+    }
+
+    market_data.addAnalyticsListener([&](const std::string& instrument, const BookAnalytics& analytics) {
+        ws_server.broadcastAnalytics(instrument, toJson(analytics));
+        ws_server.broadcastBbo(instrument, analytics.sequence, analytics.timestamp, analytics.best_bid,
+                               analytics.best_bid_amount, analytics.best_ask, analytics.best_ask_amount);
+        risk_engine.setBbo(risk_engine.find(instrument), analytics.best_bid, analytics.best_ask);
+        positions.onMark(instrument, analytics.mid);
+        scheduler.onBook(instrument, analytics.best_bid, analytics.best_ask);
+        if (instrument == "BTC-PERPETUAL") {
+            option_engine.onUnderlying("BTC", analytics.mid, analytics.timestamp);
+        } else {
+            option_engine.onOptionQuote(instrument, analytics.best_bid, analytics.best_ask);
+        }
+    });
+
+    candles.addListener([&](const std::string& instrument, const std::string& timeframe, const Candle& candle) {
+        ws_server.broadcastCandle(instrument, timeframe, candle);
+    });
+
+    trade_tape.addListener([&](const std::string& instrument, const TradeRing& ring, uint64_t first, uint64_t end) {
+        candles.onTrades(instrument, ring, first, end);
+    });
+
+    // Fetch order book data and trades and broadcast to WebSocket clients in a separate thread
     std::thread orderbook_thread([&]() {
         try {
-            while (true) {
-                auto orderbook = api_handler.getOrderBook("BTC-PERPETUAL");
-                if (!orderbook.empty()) {
-                    ws_server.broadcastOrderbook("BTC-PERPETUAL", orderbook);
+            while (running) {
+                for (const auto& instrument : demand.active()) {
+                    uint64_t& last_seq = last_trade_seq[instrument];
+                    auto trades_response = api_handler.getLastTrades(instrument, last_seq == 0 ? 0 : last_seq + 1);
+                    json trades_json = json::parse(trades_response, nullptr, false);
+                    if (!trades_json.is_discarded() && trades_json.contains("result")) {
+                        std::vector<Trade> trades = parseTrades(trades_json["result"], last_seq);
+                        trade_tape.append(instrument, trades);
+                        ws_server.broadcastTrades(instrument, trades);
+                        if (!trades.empty()) {
+                            last_seq = trades.back().trade_seq;
+                        }
+                    }
+
+                    auto orderbook = api_handler.getOrderBook(instrument);
+                    if (orderbook.empty()) {
+                        continue;
+                    }
+                    json book = json::parse(orderbook, nullptr, false);
+                    if (!book.is_discarded() && book.contains("result")) {
+                        tick_store.appendOrderBook(book["result"]);
+                        BookUpdate update = market_data.onOrderBook(instrument, book["result"]);
+                        if (update.sequence != 0) {
+                            ws_server.broadcastOrderbook(update);
+                        }
+                    }
                 }
                 std::this_thread::sleep_for(std::chrono::seconds(1));
             }
@@ -51,6 +238,28 @@ int main() {
         }
     });
 
+    std::thread reconcile_thread([&]() {
+        int64_t waited_ms = 0;
+        int64_t since_universe_ms = 0;
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if ((waited_ms += 100) < 30000) {
+                continue;
+            }
+            waited_ms = 0;
+            if ((since_universe_ms += 30000) >= 600000) {
+                since_universe_ms = 0;
+                loadUniverse();
+            }
+            // Also settles orders whose placement reply was lost
+            order_manager.reconcileOpenOrders("BTC");
+            size_t corrected = positions.reconcile(order_manager.getPosition("BTC", "future"));
+            if (corrected > 0) {
+                Logger::log("Reconciliation corrected " + std::to_string(corrected) + " positions.");
+            }
+        }
+    });
+
     // Example API Operations
 
     // Place an order
@@ -90,21 +299,29 @@ int main() {
         Logger::log("Exception occurred while modifying order: " + std::string(e.what()));
     }
 
-    // Get positions
-    try {
-        Logger::log("Getting current positions...");
-        std::string position = order_manager.getPosition("BTC", "future");
-        if (!position.empty()) {
-            Logger::log("Positions: " + position);
-        } else {
-            Logger::log("Failed to fetch positions.");
+    // Cancel whatever this process still has open before shutting down,
+    // leaving orders placed by anything else on the account alone
+    std::vector<std::string> open_order_ids;
+    for (const OrderRecord& order : order_manager.openOrders()) {
+        if (order.exchange_id[0] != '\0') {
+            open_order_ids.emplace_back(order.exchangeId());
         }
-    } catch (const std::exception& e) {
-        Logger::log("Exception occurred while fetching positions: " + std::string(e.what()));
+    }
+    order_manager.cancelOrders(open_order_ids);
+
+    // Get positions
+    for (const Position& position : positions.positions()) {
+        Logger::log("Position " + position.instrument + ": " + std::to_string(position.size) +
+                    " @ " + std::to_string(position.average_price) +
+                    ", realized " + std::to_string(position.realized_pnl) +
+                    ", unrealized " + std::to_string(position.unrealized_pnl));
     }
 
     // Stop the WebSocket server
     try {
+        running = false;
+        scheduler.stop();
+        user_stream.stop();
         ws_server.stop();
         if (ws_thread.joinable()) {
             ws_thread.join();
@@ -112,10 +329,20 @@ int main() {
         if (orderbook_thread.joinable()) {
             orderbook_thread.join();
         }
+        if (reconcile_thread.joinable()) {
+            reconcile_thread.join();
+        }
     } catch (const std::exception& e) {
         Logger::log("Exception occurred while stopping WebSocket server: " + std::string(e.what()));
     }
 
+    // Only once every thread that can change an order has stopped
+    journal.close();
+
+    if (tick_store.save("data/orderbook_ticks.dts")) {
+        Logger::log("Saved " + std::to_string(tick_store.rows()) + " orderbook rows to tick store.");
+    }
+
     Logger::log("Deribit Order System shutting down.");
     return 0;
 }
@@ -0,0 +1,140 @@
+#include "market_data.h"
+#include "logger.h"
+#include <algorithm>
+#include <charconv>
+#include <utility>
+
+namespace {
+
+// trade_id is a string such as "ETH-123456" or "123456"; keep the number.
+uint64_t parseTradeId(const nlohmann::json& value) {
+    if (value.is_number_unsigned()) {
+        return value.get<uint64_t>();
+    }
+    if (!value.is_string()) {
+        return 0;
+    }
+    const std::string& id = value.get_ref<const std::string&>();
+    size_t digits = id.find_last_of('-');
+    digits = digits == std::string::npos ? 0 : digits + 1;
+    uint64_t number = 0;
+    std::from_chars(id.data() + digits, id.data() + id.size(), number);
+    return number;
+}
+
+}  // namespace
+
+std::vector<Trade> parseTrades(const nlohmann::json& result, uint64_t after_seq) {
+    std::vector<Trade> trades;
+    if (!result.contains("trades") || !result["trades"].is_array()) {
+        return trades;
+    }
+    for (const auto& item : result["trades"]) {
+        Trade trade;
+        trade.trade_seq = item.value("trade_seq", uint64_t{0});
+        if (trade.trade_seq <= after_seq) {
+            continue;
+        }
+        trade.trade_id = item.contains("trade_id") ? parseTradeId(item["trade_id"]) : 0;
+        trade.timestamp = item.value("timestamp", int64_t{0});
+        trade.price = item.value("price", 0.0);
+        trade.amount = item.value("amount", 0.0);
+        trade.side = item.value("direction", std::string()) == "sell" ? Side::Ask : Side::Bid;
+        trades.push_back(trade);
+    }
+    std::sort(trades.begin(), trades.end(),
+              [](const Trade& a, const Trade& b) { return a.trade_seq < b.trade_seq; });
+    return trades;
+}
+
+MarketData::Entry& MarketData::entry(const std::string& instrument) {
+    {
+        std::shared_lock lock(mutex_);
+        auto it = books_.find(instrument);
+        if (it != books_.end()) {
+            return *it->second;
+        }
+    }
+    std::unique_lock lock(mutex_);
+    auto& slot = books_[instrument];
+    if (!slot) {
+        slot = std::make_unique<Entry>(instrument);
+    }
+    return *slot;
+}
+
+const MarketData::Entry* MarketData::find(const std::string& instrument) const {
+    std::shared_lock lock(mutex_);
+    auto it = books_.find(instrument);
+    return it == books_.end() ? nullptr : it->second.get();
+}
+
+BookUpdate MarketData::onOrderBook(const std::string& instrument, const nlohmann::json& result) {
+    Entry& book_entry = entry(instrument);
+    BookUpdate update;
+    BookAnalytics analytics;
+    try {
+        std::lock_guard lock(book_entry.mutex);
+        update = book_entry.book.diffSnapshot(result);
+        book_entry.book.apply(update, [&book_entry](const LevelDelta& delta, double previous) {
+            book_entry.analytics.onDelta(delta, previous);
+        });
+        book_entry.analytics.onUpdate(book_entry.book);
+        if (!book_entry.trades && tape_) {
+            book_entry.trades = tape_->find(instrument);
+        }
+        if (book_entry.trades) {
+            book_entry.analytics.onTrades(*book_entry.trades);
+        }
+        analytics = book_entry.analytics.current();
+    } catch (const std::exception& e) {
+        Logger::log("Error applying orderbook for " + instrument + ": " + std::string(e.what()));
+        return {};
+    }
+    notify(instrument, analytics);
+    return update;
+}
+
+void MarketData::setTradeTape(const TradeTape* tape) {
+    tape_ = tape;
+}
+
+bool MarketData::getAnalytics(const std::string& instrument, BookAnalytics& analytics) const {
+    const Entry* e = find(instrument);
+    if (!e) {
+        return false;
+    }
+    std::lock_guard lock(e->mutex);
+    analytics = e->analytics.current();
+    return true;
+}
+
+bool MarketData::getBestBidAsk(const std::string& instrument, PriceLevel& bid, PriceLevel& ask) const {
+    const Entry* e = find(instrument);
+    if (!e) {
+        return false;
+    }
+    std::lock_guard lock(e->mutex);
+    return e->book.bestBid(bid) && e->book.bestAsk(ask);
+}
+
+nlohmann::json MarketData::getBook(const std::string& instrument, size_t depth) const {
+    const Entry* e = find(instrument);
+    if (!e) {
+        return nullptr;
+    }
+    std::lock_guard lock(e->mutex);
+    return e->book.toJson(depth);
+}
+
+void MarketData::addAnalyticsListener(AnalyticsListener listener) {
+    std::unique_lock lock(mutex_);
+    listeners_.push_back(std::move(listener));
+}
+
+void MarketData::notify(const std::string& instrument, const BookAnalytics& analytics) {
+    std::shared_lock lock(mutex_);
+    for (const auto& listener : listeners_) {
+        listener(instrument, analytics);
+    }
+}
@@ -0,0 +1,263 @@
+#include "option_pricer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+constexpr double kInvSqrt2Pi = 0.3989422804014327;
+constexpr double kSqrt2Pi = 2.5066282746310002;
+constexpr double kMinExpiry = 1.0 / (365.0 * 24.0 * 60.0);  // one minute
+constexpr double kMinVol = 1e-4;
+constexpr double kMaxVol = 10.0;
+constexpr size_t kMinParallelContracts = 4096;
+constexpr size_t kImpliedVolTile = 256;
+constexpr double kMinTimeValue = 1e-9;  // relative to forward + strike
+
+inline double normPdf(double x) {
+    return kInvSqrt2Pi * std::exp(-0.5 * x * x);
+}
+
+// N(x) and N(-x) from one Abramowitz & Stegun 26.2.17 tail evaluation
+// (|error| < 7.5e-8), written without branches. The small side is the tail
+// itself, so out-of-the-money values keep their relative precision.
+inline void normCdf(double x, double& cdf, double& cdf_neg) {
+    double ax = std::fabs(x);
+    double t = 1.0 / (1.0 + 0.2316419 * ax);
+    double poly = t * (0.319381530 + t * (-0.356563782 + t * (1.781477937 + t * (-1.821255978 + t * 1.330274429))));
+    double tail = normPdf(ax) * poly;
+    cdf = x >= 0.0 ? 1.0 - tail : tail;
+    cdf_neg = x >= 0.0 ? tail : 1.0 - tail;
+}
+
+struct Valuation {
+    double price;
+    double delta;
+    double gamma;
+    double vega;
+    double theta;
+};
+
+// Black-76 on the forward; for Black-Scholes the spot is carried to a forward
+// first (bs = 1) and delta/gamma/theta are mapped back to spot sensitivities.
+// The out-of-the-money side is priced from the CDF tails and the other side
+// is derived by put-call parity to avoid cancellation deep in the money.
+inline Valuation value(double bs, double underlying, double strike, double expiry, double rate,
+                       double dividend, double call, double vol) {
+    double t = std::max(expiry, kMinExpiry);
+    double sigma = std::min(std::max(vol, kMinVol), kMaxVol);
+    double carry = std::exp(bs * (rate - dividend) * t);
+    double forward = underlying * carry;
+    double discount = std::exp(-rate * t);
+    double sqrt_t = std::sqrt(t);
+    double sd = sigma * sqrt_t;
+    double d1 = (std::log(forward / strike) + 0.5 * sd * sd) / sd;
+    double d2 = d1 - sd;
+    double n1, n1_neg, n2, n2_neg;
+    normCdf(d1, n1, n1_neg);
+    normCdf(d2, n2, n2_neg);
+    double pdf = normPdf(d1);
+    double put = 1.0 - call;
+
+    double parity = discount * (forward - strike);
+    bool call_otm = forward < strike;
+    double otm = call_otm ? discount * (forward * n1 - strike * n2) : discount * (strike * n2_neg - forward * n1_neg);
+    double call_price = call_otm ? otm : otm + parity;
+    double put_price = call_otm ? otm - parity : otm;
+
+    Valuation v;
+    v.price = call * call_price + put * put_price;
+    double forward_delta = discount * (n1 - put);
+    v.delta = forward_delta * carry;
+    v.gamma = discount * pdf / (forward * sd) * carry * carry;
+    v.vega = discount * forward * pdf * sqrt_t;
+    v.theta = rate * v.price - discount * forward * pdf * sigma / (2.0 * sqrt_t)
+              - bs * (rate - dividend) * forward * forward_delta;
+    return v;
+}
+
+}  // namespace
+
+void OptionChain::resize(size_t n) {
+    for (auto* column : {&forward, &strike, &expiry, &rate, &dividend, &is_call, &volatility, &market_price,
+                         &price, &delta, &gamma, &vega, &theta, &implied_vol}) {
+        column->resize(n, 0.0);
+    }
+}
+
+size_t OptionChain::add(double forward_price, double strike_price, double expiry_years, bool call,
+                        double volatility_value, double rate_value, double dividend_value) {
+    size_t index = size();
+    resize(index + 1);
+    forward[index] = forward_price;
+    strike[index] = strike_price;
+    expiry[index] = expiry_years;
+    is_call[index] = call ? 1.0 : 0.0;
+    volatility[index] = volatility_value;
+    rate[index] = rate_value;
+    dividend[index] = dividend_value;
+    return index;
+}
+
+OptionPricer::OptionPricer(PricingModel model, size_t threads)
+    : model_(model), threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {
+    workers_.reserve(threads_ - 1);
+    for (size_t worker = 0; worker + 1 < threads_; ++worker) {
+        workers_.emplace_back(&OptionPricer::work, this, worker);
+    }
+}
+
+OptionPricer::~OptionPricer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+// The caller prices the first chunk; pool worker w takes chunk w + 1.
+void OptionPricer::parallel(size_t n, const Range& fn) const {
+    if (workers_.empty() || n < kMinParallelContracts) {
+        fn(0, n);
+        return;
+    }
+    size_t chunks = std::min(threads_, n / (kMinParallelContracts / 4));
+    size_t chunk = (n + chunks - 1) / chunks;
+    std::lock_guard<std::mutex> batch(batch_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        job_size_ = n;
+        chunk_ = chunk;
+        busy_ = workers_.size();
+        ++generation_;
+    }
+    start_cv_.notify_all();
+    fn(0, std::min(n, chunk));
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return busy_ == 0; });
+    job_ = nullptr;
+}
+
+void OptionPricer::work(size_t worker) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        start_cv_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+        if (stopping_) {
+            return;
+        }
+        seen = generation_;
+        const Range* job = job_;
+        size_t begin = (worker + 1) * chunk_;
+        size_t end = std::min(job_size_, begin + chunk_);
+        lock.unlock();
+        if (begin < end) {
+            (*job)(begin, end);
+        }
+        lock.lock();
+        if (--busy_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
+
+void OptionPricer::price(OptionChain& chain) const {
+    parallel(chain.size(), [this, &chain](size_t begin, size_t end) { price(chain, begin, end); });
+}
+
+void OptionPricer::price(OptionChain& chain, size_t begin, size_t end) const {
+    const double bs = model_ == PricingModel::BlackScholes ? 1.0 : 0.0;
+    const double* f = chain.forward.data();
+    const double* k = chain.strike.data();
+    const double* t = chain.expiry.data();
+    const double* r = chain.rate.data();
+    const double* q = chain.dividend.data();
+    const double* c = chain.is_call.data();
+    const double* vol = chain.volatility.data();
+    double* price = chain.price.data();
+    double* delta = chain.delta.data();
+    double* gamma = chain.gamma.data();
+    double* vega = chain.vega.data();
+    double* theta = chain.theta.data();
+
+    for (size_t i = begin; i < end; ++i) {
+        Valuation v = value(bs, f[i], k[i], t[i], r[i], q[i], c[i], vol[i]);
+        price[i] = v.price;
+        delta[i] = v.delta;
+        gamma[i] = v.gamma;
+        vega[i] = v.vega;
+        theta[i] = v.theta;
+    }
+}
+
+void OptionPricer::impliedVol(OptionChain& chain, int iterations) const {
+    parallel(chain.size(), [this, &chain, iterations](size_t begin, size_t end) {
+        impliedVol(chain, begin, end, iterations);
+    });
+}
+
+void OptionPricer::impliedVol(OptionChain& chain, size_t begin, size_t end, int iterations) const {
+    const double bs = model_ == PricingModel::BlackScholes ? 1.0 : 0.0;
+    const double* f = chain.forward.data();
+    const double* k = chain.strike.data();
+    const double* t = chain.expiry.data();
+    const double* r = chain.rate.data();
+    const double* q = chain.dividend.data();
+    const double* c = chain.is_call.data();
+    const double* target = chain.market_price.data();
+    double* iv = chain.implied_vol.data();
+
+    // Tiles keep the working set in cache while every lane runs the same
+    // fixed number of safeguarded Newton steps: each evaluation narrows a
+    // [lo, hi] bracket and steps that leave it fall back to bisection.
+    // Newton runs on the log of the time value, which is close to linear in
+    // vol even far out of the money where the price itself is very convex.
+    double lo[kImpliedVolTile];
+    double hi[kImpliedVolTile];
+    double intrinsic[kImpliedVolTile];
+    for (size_t tile = begin; tile < end; tile += kImpliedVolTile) {
+        size_t tile_end = std::min(end, tile + kImpliedVolTile);
+
+        for (size_t i = tile; i < tile_end; ++i) {
+            double expiry = std::max(t[i], kMinExpiry);
+            double forward = f[i] * std::exp(bs * (r[i] - q[i]) * expiry);
+            double discount = std::exp(-r[i] * expiry);
+            double undiscounted = target[i] / discount;
+            double seed = kSqrt2Pi / std::sqrt(expiry) * undiscounted / forward;
+            iv[i] = std::min(std::max(seed, 0.05), 3.0);
+            lo[i - tile] = kMinVol;
+            hi[i - tile] = kMaxVol;
+            intrinsic[i - tile] =
+                discount * std::max(c[i] * (forward - k[i]) + (1.0 - c[i]) * (k[i] - forward), 0.0);
+        }
+        for (int it = 0; it < iterations; ++it) {
+            for (size_t i = tile; i < tile_end; ++i) {
+                size_t j = i - tile;
+                Valuation v = value(bs, f[i], k[i], t[i], r[i], q[i], c[i], iv[i]);
+                double diff = v.price - target[i];
+                hi[j] = diff > 0.0 ? iv[i] : hi[j];
+                lo[j] = diff > 0.0 ? lo[j] : iv[i];
+                double time_value = v.price - intrinsic[j];
+                double next = iv[i] - std::log(time_value / (target[i] - intrinsic[j])) * (time_value / v.vega);
+                // NaN or infinity (underflowed price or vega) fails the test and bisects too
+                bool inside = next >= lo[j] && next <= hi[j];
+                iv[i] = inside ? next : 0.5 * (lo[j] + hi[j]);
+            }
+        }
+        for (size_t i = tile; i < tile_end; ++i) {
+            double expiry = std::max(t[i], kMinExpiry);
+            double forward = f[i] * std::exp(bs * (r[i] - q[i]) * expiry);
+            double discount = std::exp(-r[i] * expiry);
+            double intrinsic = discount * std::max(c[i] * (forward - k[i]) + (1.0 - c[i]) * (k[i] - forward), 0.0);
+            double upper = discount * (c[i] * forward + (1.0 - c[i]) * k[i]);
+            // Time value below the kernel's precision carries no vol information.
+            double min_time_value = kMinTimeValue * (forward + k[i]);
+            bool valid = target[i] > intrinsic + min_time_value && target[i] < upper;
+            iv[i] = valid ? iv[i] : 0.0;
+        }
+    }
+}
@@ -0,0 +1,316 @@
+#include "option_pricing_engine.h"
+#include "logger.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+constexpr double kMsPerYear = 365.0 * 24.0 * 60.0 * 60.0 * 1000.0;
+constexpr int64_t kExpiryHourMs = 8 * 60 * 60 * 1000;  // Deribit options expire at 08:00 UTC
+
+// Days since 1970-01-01 for a proleptic Gregorian date.
+int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+bool parseExpiry(const std::string& text, int64_t& expiry_ms) {
+    static const char* kMonths[] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+                                    "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+    if (text.size() < 6 || text.size() > 7) {
+        return false;
+    }
+    size_t day_digits = text.size() - 5;
+    if (!std::isdigit(static_cast<unsigned char>(text[0])) ||
+        !std::isdigit(static_cast<unsigned char>(text[day_digits - 1]))) {
+        return false;
+    }
+    unsigned day = static_cast<unsigned>(std::stoi(text.substr(0, day_digits)));
+    std::string month = text.substr(day_digits, 3);
+    unsigned year = 2000 + static_cast<unsigned>(std::stoi(text.substr(day_digits + 3)));
+    for (unsigned m = 0; m < 12; ++m) {
+        if (month == kMonths[m]) {
+            expiry_ms = daysFromCivil(year, m + 1, day) * 86400000 + kExpiryHourMs;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string currencyOf(const std::string& instrument) {
+    return instrument.substr(0, instrument.find('-'));
+}
+
+}  // namespace
+
+bool parseOptionInstrument(const std::string& instrument, OptionContract& contract) {
+    try {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        for (size_t pos = instrument.find('-'); pos != std::string::npos; pos = instrument.find('-', start)) {
+            parts.push_back(instrument.substr(start, pos - start));
+            start = pos + 1;
+        }
+        parts.push_back(instrument.substr(start));
+        if (parts.size() != 4 || (parts[3] != "C" && parts[3] != "P")) {
+            return false;
+        }
+
+        OptionContract parsed;
+        parsed.instrument = instrument;
+        parsed.currency = parts[0];
+        if (!parseExpiry(parts[1], parsed.expiry_ms)) {
+            return false;
+        }
+        std::string strike = parts[2];
+        std::replace(strike.begin(), strike.end(), 'd', '.');  // e.g. 0d625 for fractional strikes
+        parsed.strike = std::stod(strike);
+        parsed.is_call = parts[3] == "C";
+        contract = std::move(parsed);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+OptionPricingEngine::OptionPricingEngine(size_t threads, double default_vol)
+    : pricer_(PricingModel::Black76, threads), default_vol_(default_vol) {}
+
+void OptionPricingEngine::setContractListener(ContractListener listener) {
+    std::lock_guard lock(mutex_);
+    contract_listener_ = std::move(listener);
+}
+
+bool OptionPricingEngine::loadPositions(const std::string& response) {
+    try {
+        auto data = nlohmann::json::parse(response);
+        if (!data.contains("result") || !data["result"].is_array()) {
+            Logger::log("Positions response has no result array.");
+            return false;
+        }
+        for (const auto& position : data["result"]) {
+            if (position.value("kind", "") != "option") {
+                continue;
+            }
+            std::string instrument = position.value("instrument_name", "");
+            if (!addContract(instrument, position.value("size", 0.0))) {
+                Logger::log("Skipping unrecognized option instrument: " + instrument);
+            }
+        }
+        return true;
+    } catch (const std::exception& e) {
+        Logger::log("Error loading option positions: " + std::string(e.what()));
+        return false;
+    }
+}
+
+bool OptionPricingEngine::addContract(const std::string& instrument, double position) {
+    OptionContract contract;
+    if (!parseOptionInstrument(instrument, contract)) {
+        return false;
+    }
+
+    ContractListener listener;
+    {
+        std::lock_guard lock(mutex_);
+        Chain& chain = chains_[contract.currency];
+        auto it = chain.index.find(instrument);
+        if (it != chain.index.end()) {
+            chain.position[it->second] = position;
+            return true;
+        }
+        insert(chain, std::move(contract), position);
+        listener = contract_listener_;
+    }
+    if (listener) {
+        listener(instrument);
+    }
+    return true;
+}
+
+void OptionPricingEngine::insert(Chain& chain, OptionContract&& contract, double position) {
+    size_t index = chain.soa.add(chain.forward, contract.strike, 0.0, contract.is_call, default_vol_);
+    chain.index.emplace(contract.instrument, index);
+    chain.contracts.push_back(std::move(contract));
+    chain.position.push_back(position);
+    chain.quote.push_back(0.0);
+    chain.is_dirty.push_back(0);
+}
+
+void OptionPricingEngine::setPosition(const std::string& instrument, double position) {
+    if (!addContract(instrument, position)) {
+        Logger::log("Cannot track position for unrecognized option instrument: " + instrument);
+    }
+}
+
+void OptionPricingEngine::onFill(const std::string& instrument, double quantity) {
+    OptionContract contract;
+    if (!parseOptionInstrument(instrument, contract)) {
+        return;
+    }
+    ContractListener listener;
+    {
+        std::lock_guard lock(mutex_);
+        Chain& chain = chains_[contract.currency];
+        auto it = chain.index.find(instrument);
+        if (it != chain.index.end()) {
+            chain.position[it->second] += quantity;
+            return;
+        }
+        insert(chain, std::move(contract), quantity);
+        listener = contract_listener_;
+    }
+    if (listener) {
+        listener(instrument);
+    }
+}
+
+void OptionPricingEngine::onUnderlying(const std::string& currency, double forward, int64_t timestamp_ms) {
+    if (forward <= 0.0) {
+        return;
+    }
+    std::lock_guard lock(mutex_);
+    auto it = chains_.find(currency);
+    if (it == chains_.end()) {
+        return;
+    }
+    Chain& chain = it->second;
+    chain.forward = forward;
+    chain.timestamp_ms = timestamp_ms;
+    std::fill(chain.soa.forward.begin(), chain.soa.forward.end(), forward);
+    for (size_t i = 0; i < chain.contracts.size(); ++i) {
+        chain.soa.expiry[i] = static_cast<double>(chain.contracts[i].expiry_ms - timestamp_ms) / kMsPerYear;
+    }
+    reinvert(chain);
+    pricer_.price(chain.soa);
+}
+
+void OptionPricingEngine::onOptionQuote(const std::string& instrument, double bid, double ask) {
+    double mid = bid > 0.0 && ask > 0.0 ? (bid + ask) / 2.0 : std::max(bid, ask);
+    if (mid <= 0.0) {
+        return;
+    }
+    std::lock_guard lock(mutex_);
+    auto chain_it = chains_.find(currencyOf(instrument));
+    if (chain_it == chains_.end()) {
+        return;
+    }
+    Chain& chain = chain_it->second;
+    auto it = chain.index.find(instrument);
+    if (it == chain.index.end()) {
+        return;
+    }
+    chain.quote[it->second] = mid;
+    if (!chain.is_dirty[it->second]) {
+        chain.is_dirty[it->second] = 1;
+        chain.dirty.push_back(it->second);
+    }
+}
+
+// Inverts implied vol for the contracts quoted since the last tick only,
+// packed into a scratch chain so the batch kernel runs over contiguous data.
+void OptionPricingEngine::reinvert(Chain& chain) {
+    if (chain.dirty.empty() || chain.forward <= 0.0) {
+        return;
+    }
+    OptionChain scratch;
+    scratch.resize(chain.dirty.size());
+    for (size_t j = 0; j < chain.dirty.size(); ++j) {
+        size_t i = chain.dirty[j];
+        scratch.forward[j] = chain.soa.forward[i];
+        scratch.strike[j] = chain.soa.strike[i];
+        scratch.expiry[j] = chain.soa.expiry[i];
+        scratch.rate[j] = chain.soa.rate[i];
+        scratch.is_call[j] = chain.soa.is_call[i];
+        // Deribit option premiums are quoted in the underlying currency.
+        scratch.market_price[j] = chain.quote[i] * chain.forward;
+    }
+    pricer_.impliedVol(scratch);
+    for (size_t j = 0; j < chain.dirty.size(); ++j) {
+        size_t i = chain.dirty[j];
+        chain.soa.market_price[i] = scratch.market_price[j];
+        chain.soa.implied_vol[i] = scratch.implied_vol[j];
+        if (scratch.implied_vol[j] > 0.0) {
+            chain.soa.volatility[i] = scratch.implied_vol[j];
+        }
+        chain.is_dirty[i] = 0;
+    }
+    chain.dirty.clear();
+}
+
+bool OptionPricingEngine::locate(const std::string& instrument, const Chain*& chain, size_t& index) const {
+    auto chain_it = chains_.find(currencyOf(instrument));
+    if (chain_it == chains_.end()) {
+        return false;
+    }
+    auto it = chain_it->second.index.find(instrument);
+    if (it == chain_it->second.index.end()) {
+        return false;
+    }
+    chain = &chain_it->second;
+    index = it->second;
+    return true;
+}
+
+bool OptionPricingEngine::getGreeks(const std::string& instrument, OptionGreeks& greeks) const {
+    std::lock_guard lock(mutex_);
+    const Chain* chain = nullptr;
+    size_t i = 0;
+    if (!locate(instrument, chain, i)) {
+        return false;
+    }
+    const OptionChain& soa = chain->soa;
+    greeks.price = soa.price[i];
+    greeks.delta = soa.delta[i];
+    greeks.gamma = soa.gamma[i];
+    greeks.vega = soa.vega[i];
+    greeks.theta = soa.theta[i];
+    greeks.implied_vol = soa.implied_vol[i];
+    greeks.position = chain->position[i];
+    return true;
+}
+
+OptionGreeks OptionPricingEngine::portfolioGreeks(const std::string& currency) const {
+    std::lock_guard lock(mutex_);
+    OptionGreeks total;
+    auto it = chains_.find(currency);
+    if (it == chains_.end()) {
+        return total;
+    }
+    const Chain& chain = it->second;
+    for (size_t i = 0; i < chain.position.size(); ++i) {
+        double size = chain.position[i];
+        total.price += size * chain.soa.price[i];
+        total.delta += size * chain.soa.delta[i];
+        total.gamma += size * chain.soa.gamma[i];
+        total.vega += size * chain.soa.vega[i];
+        total.theta += size * chain.soa.theta[i];
+        total.position += size;
+    }
+    return total;
+}
+
+size_t OptionPricingEngine::contracts() const {
+    std::lock_guard lock(mutex_);
+    size_t total = 0;
+    for (const auto& [currency, chain] : chains_) {
+        total += chain.contracts.size();
+    }
+    return total;
+}
+
+std::vector<std::string> OptionPricingEngine::instruments() const {
+    std::lock_guard lock(mutex_);
+    std::vector<std::string> names;
+    for (const auto& [currency, chain] : chains_) {
+        for (const auto& contract : chain.contracts) {
+            names.push_back(contract.instrument);
+        }
+    }
+    return names;
+}
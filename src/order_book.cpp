@@ -0,0 +1,120 @@
+#include "order_book.h"
+#include <utility>
+
+namespace {
+
+template <typename Levels>
+void diffSide(const Levels& current, const nlohmann::json& levels, Side side, std::vector<LevelDelta>& out) {
+    Levels next;
+    for (const auto& level : levels) {
+        next[level[0].get<double>()] = level[1].get<double>();
+    }
+    for (const auto& [price, amount] : current) {
+        if (next.find(price) == next.end()) {
+            out.push_back({side, price, 0.0});
+        }
+    }
+    for (const auto& [price, amount] : next) {
+        auto it = current.find(price);
+        if (it == current.end() || it->second != amount) {
+            out.push_back({side, price, amount});
+        }
+    }
+}
+
+template <typename Levels>
+double applyLevel(Levels& levels, double price, double amount) {
+    auto it = levels.find(price);
+    double previous = it == levels.end() ? 0.0 : it->second;
+    if (amount <= 0.0) {
+        if (it != levels.end()) {
+            levels.erase(it);
+        }
+    } else if (it == levels.end()) {
+        levels.emplace(price, amount);
+    } else {
+        it->second = amount;
+    }
+    return previous;
+}
+
+template <typename Levels>
+nlohmann::json levelsToJson(const Levels& levels, size_t depth) {
+    nlohmann::json out = nlohmann::json::array();
+    for (const auto& [price, amount] : levels) {
+        if (depth != 0 && out.size() >= depth) {
+            break;
+        }
+        out.push_back({price, amount});
+    }
+    return out;
+}
+
+}  // namespace
+
+OrderBook::OrderBook(std::string instrument) : instrument_(std::move(instrument)) {}
+
+BookUpdate OrderBook::diffSnapshot(const nlohmann::json& result) const {
+    BookUpdate update;
+    update.instrument = instrument_;
+    update.sequence = sequence_ + 1;
+    update.timestamp = result.value("timestamp", int64_t{0});
+    if (result.contains("bids")) {
+        diffSide(bids_, result["bids"], Side::Bid, update.deltas);
+    }
+    if (result.contains("asks")) {
+        diffSide(asks_, result["asks"], Side::Ask, update.deltas);
+    }
+    return update;
+}
+
+void OrderBook::apply(const BookUpdate& update, const LevelListener& on_level) {
+    for (const auto& delta : update.deltas) {
+        double previous = applyDelta(delta);
+        if (on_level) {
+            on_level(delta, previous);
+        }
+    }
+    sequence_ = update.sequence;
+    timestamp_ = update.timestamp;
+}
+
+double OrderBook::applyDelta(const LevelDelta& delta) {
+    if (delta.side == Side::Bid) {
+        return applyLevel(bids_, delta.price, delta.amount);
+    }
+    return applyLevel(asks_, delta.price, delta.amount);
+}
+
+void OrderBook::clear() {
+    bids_.clear();
+    asks_.clear();
+    sequence_ = 0;
+    timestamp_ = 0;
+}
+
+bool OrderBook::bestBid(PriceLevel& level) const {
+    if (bids_.empty()) {
+        return false;
+    }
+    level = {bids_.begin()->first, bids_.begin()->second};
+    return true;
+}
+
+bool OrderBook::bestAsk(PriceLevel& level) const {
+    if (asks_.empty()) {
+        return false;
+    }
+    level = {asks_.begin()->first, asks_.begin()->second};
+    return true;
+}
+
+nlohmann::json OrderBook::toJson(size_t depth) const {
+    return {
+        {"instrument_name", instrument_},
+        {"sequence", sequence_},
+        {"timestamp", timestamp_},
+        {"bids", levelsToJson(bids_, depth)},
+        {"asks", levelsToJson(asks_, depth)}
+    };
+}
@@ -0,0 +1,98 @@
+#include "order_book_analytics.h"
+#include <algorithm>
+#include <cmath>
+
+nlohmann::json toJson(const BookAnalytics& analytics) {
+    return {
+        {"sequence", analytics.sequence},
+        {"timestamp", analytics.timestamp},
+        {"best_bid", analytics.best_bid},
+        {"best_ask", analytics.best_ask},
+        {"best_bid_amount", analytics.best_bid_amount},
+        {"best_ask_amount", analytics.best_ask_amount},
+        {"mid", analytics.mid},
+        {"microprice", analytics.microprice},
+        {"spread", analytics.spread},
+        {"top_imbalance", analytics.top_imbalance},
+        {"bid_depth", analytics.bid_depth},
+        {"ask_depth", analytics.ask_depth},
+        {"depth_imbalance", analytics.depth_imbalance},
+        {"bid_vwap", analytics.bid_vwap},
+        {"ask_vwap", analytics.ask_vwap},
+        {"trade_vwap", analytics.trade_vwap},
+        {"trade_volume", analytics.trade_volume},
+        {"spread_samples", analytics.spread_samples},
+        {"spread_mean", analytics.spread_mean},
+        {"spread_stddev", analytics.spread_stddev},
+        {"spread_min", analytics.spread_min},
+        {"spread_max", analytics.spread_max}
+    };
+}
+
+OrderBookAnalytics::OrderBookAnalytics(int64_t trade_window_ms) : trade_window_ms_(trade_window_ms) {}
+
+void OrderBookAnalytics::onDelta(const LevelDelta& delta, double previous_amount) {
+    double change = std::max(delta.amount, 0.0) - previous_amount;
+    if (delta.side == Side::Bid) {
+        current_.bid_depth += change;
+        bid_notional_ += change * delta.price;
+    } else {
+        current_.ask_depth += change;
+        ask_notional_ += change * delta.price;
+    }
+}
+
+void OrderBookAnalytics::onUpdate(const OrderBook& book) {
+    BookAnalytics& a = current_;
+    a.sequence = book.sequence();
+    a.timestamp = book.timestamp();
+
+    double total = a.bid_depth + a.ask_depth;
+    a.depth_imbalance = total > 0.0 ? (a.bid_depth - a.ask_depth) / total : 0.0;
+    a.bid_vwap = a.bid_depth > 0.0 ? bid_notional_ / a.bid_depth : 0.0;
+    a.ask_vwap = a.ask_depth > 0.0 ? ask_notional_ / a.ask_depth : 0.0;
+
+    PriceLevel bid;
+    PriceLevel ask;
+    bool has_bid = book.bestBid(bid);
+    bool has_ask = book.bestAsk(ask);
+    a.best_bid = has_bid ? bid.price : 0.0;
+    a.best_ask = has_ask ? ask.price : 0.0;
+    a.best_bid_amount = has_bid ? bid.amount : 0.0;
+    a.best_ask_amount = has_ask ? ask.amount : 0.0;
+    if (!has_bid || !has_ask) {
+        a.mid = 0.0;
+        a.spread = 0.0;
+        a.top_imbalance = 0.0;
+        a.microprice = 0.0;
+        return;
+    }
+    a.mid = (bid.price + ask.price) / 2.0;
+    a.spread = ask.price - bid.price;
+    double touch = bid.amount + ask.amount;
+    a.top_imbalance = touch > 0.0 ? (bid.amount - ask.amount) / touch : 0.0;
+    // Microprice weights each side's price by the opposite side's size.
+    a.microprice = touch > 0.0 ? (bid.price * ask.amount + ask.price * bid.amount) / touch : a.mid;
+
+    // Welford running mean/variance of the spread
+    ++a.spread_samples;
+    double delta = a.spread - a.spread_mean;
+    a.spread_mean += delta / static_cast<double>(a.spread_samples);
+    spread_m2_ += delta * (a.spread - a.spread_mean);
+    a.spread_stddev = a.spread_samples > 1 ? std::sqrt(spread_m2_ / static_cast<double>(a.spread_samples - 1)) : 0.0;
+    a.spread_min = a.spread_samples == 1 ? a.spread : std::min(a.spread_min, a.spread);
+    a.spread_max = a.spread_samples == 1 ? a.spread : std::max(a.spread_max, a.spread);
+}
+
+void OrderBookAnalytics::onTrades(const TradeRing& trades) {
+    int64_t since = current_.timestamp - trade_window_ms_;
+    current_.trade_volume = trades.volumeSince(since);
+    current_.trade_vwap = trades.vwapSince(since);
+}
+
+void OrderBookAnalytics::reset() {
+    bid_notional_ = 0.0;
+    ask_notional_ = 0.0;
+    spread_m2_ = 0.0;
+    current_ = BookAnalytics{};
+}
@@ -0,0 +1,359 @@
+#include "order_journal.h"
+#include "logger.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+#include <unordered_map>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char kFileMagic[4] = {'D', 'O', 'J', '1'};
+constexpr uint32_t kFileVersion = 1;
+
+static_assert(std::is_trivially_copyable<OrderRecord>::value, "journal entries are raw record bytes");
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+bool flushToDisk(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Read-only view of a whole file; empty if it is missing or empty.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+            return;
+        }
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping_) {
+            return;
+        }
+        data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        size_ = data_ ? static_cast<size_t>(size.QuadPart) : 0;
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || st.st_size == 0) {
+            return;
+        }
+        void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (data == MAP_FAILED) {
+            return;
+        }
+        madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+        data_ = static_cast<const uint8_t*>(data);
+        size_ = static_cast<size_t>(st.st_size);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+        }
+        if (file_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_);
+        }
+#else
+        if (data_) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool exists() const {
+#ifdef _WIN32
+        return file_ != INVALID_HANDLE_VALUE;
+#else
+        return fd_ >= 0;
+#endif
+    }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+}  // namespace
+
+const char* toString(JournalEvent event) {
+    switch (event) {
+    case JournalEvent::Intent: return "intent";
+    case JournalEvent::Ack: return "ack";
+    case JournalEvent::Fill: return "fill";
+    case JournalEvent::Amend: return "amend";
+    case JournalEvent::Cancel: return "cancel";
+    case JournalEvent::Reject: return "reject";
+    case JournalEvent::Checkpoint: return "checkpoint";
+    }
+    return "unknown";
+}
+
+OrderJournal::~OrderJournal() {
+    close();
+}
+
+uint32_t OrderJournal::checksum(const Entry& entry) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&entry);
+    return crc32(bytes + sizeof(entry.checksum), sizeof(Entry) - sizeof(entry.checksum));
+}
+
+bool OrderJournal::replay(const std::string& path, std::vector<OrderRecord>& recovered) {
+    recovered.clear();
+    MappedFile file(path);
+    if (!file.exists()) {
+        return true;
+    }
+    FileHeader header;
+    if (file.size() < sizeof(header)) {
+        Logger::log("Order journal has no header, ignoring it: " + path);
+        return file.size() == 0;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) != 0 || header.version != kFileVersion ||
+        header.entry_size != sizeof(Entry)) {
+        Logger::log("Invalid order journal: " + path);
+        return false;
+    }
+
+    // Entries are read in place; only the latest record per order is kept.
+    std::unordered_map<uint64_t, const OrderRecord*> latest;
+    const uint8_t* data = file.data() + sizeof(header);
+    size_t count = (file.size() - sizeof(header)) / sizeof(Entry);
+    size_t valid = 0;
+    for (; valid < count; ++valid) {
+        const auto* entry = reinterpret_cast<const Entry*>(data + valid * sizeof(Entry));
+        if (entry->sequence != valid + 1 || entry->checksum != checksum(*entry) || entry->record.client_id == 0) {
+            break;
+        }
+        latest[entry->record.client_id] = &entry->record;
+    }
+    if (valid < count || file.size() != sizeof(header) + count * sizeof(Entry)) {
+        Logger::log("Order journal ends in a torn or corrupt entry after " + std::to_string(valid) +
+                    " entries; dropping the rest.");
+    }
+
+    for (const auto& order : latest) {
+        if (!isTerminal(order.second->state)) {
+            OrderRecord record = *order.second;
+            record.amend_flags = 0;  // edits and cancels in flight died with the process
+            record.pending_quantity = 0.0;
+            record.pending_price = 0.0;
+            recovered.push_back(record);
+        }
+    }
+    std::sort(recovered.begin(), recovered.end(),
+              [](const OrderRecord& a, const OrderRecord& b) { return a.client_id < b.client_id; });
+    Logger::log("Replayed " + std::to_string(valid) + " journal entries: " + std::to_string(recovered.size()) +
+                " open orders.");
+    return true;
+}
+
+// Written beside the journal and renamed over it, so a crash while
+// rewriting leaves the old journal intact.
+bool OrderJournal::writeFile(const std::string& path, const std::vector<OrderRecord>& records) {
+    std::string temp = path + ".tmp";
+    std::FILE* file = std::fopen(temp.c_str(), "wb");
+    if (!file) {
+        Logger::log("Failed to open order journal for writing: " + temp);
+        return false;
+    }
+    FileHeader header{};
+    std::memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+    header.version = kFileVersion;
+    header.entry_size = sizeof(Entry);
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t sequence = 0;
+    for (const auto& record : records) {
+        Entry entry;
+        entry.event = JournalEvent::Checkpoint;
+        entry.sequence = ++sequence;
+        entry.record = record;
+        entry.checksum = checksum(entry);
+        ok = ok && std::fwrite(&entry, sizeof(entry), 1, file) == 1;
+    }
+    ok = flushToDisk(file) && ok;
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code error;
+    if (ok) {
+        std::filesystem::rename(temp, path, error);
+    }
+    if (!ok || error) {
+        Logger::log("Failed to rewrite order journal: " + path);
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+    return true;
+}
+
+bool OrderJournal::open(const std::string& path, std::vector<OrderRecord>& recovered) {
+    close();
+    if (!replay(path, recovered) || !writeFile(path, recovered)) {
+        return false;
+    }
+    file_ = std::fopen(path.c_str(), "ab");
+    if (!file_) {
+        Logger::log("Failed to open order journal for appending: " + path);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    path_ = path;
+    appended_ = durable_ = recovered.size();
+    failed_ = false;
+    running_ = true;
+    writer_ = std::thread(&OrderJournal::run, this);
+    return true;
+}
+
+void OrderJournal::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    pending_cv_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+void OrderJournal::append(JournalEvent event, const OrderRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+        return;
+    }
+    Entry& entry = pending_.emplace_back();
+    entry.event = event;
+    entry.sequence = ++appended_;
+    entry.record = record;
+    if (pending_.size() == 1) {
+        pending_cv_.notify_one();  // the writer only sleeps on an empty batch
+    }
+}
+
+bool OrderJournal::sync() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = appended_;
+    durable_cv_.wait(lock, [&] { return durable_ >= target || failed_ || !running_; });
+    return durable_ >= target;
+}
+
+uint64_t OrderJournal::appended() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return appended_;
+}
+
+uint64_t OrderJournal::durable() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return durable_;
+}
+
+bool OrderJournal::writeBatch(const std::vector<Entry>& batch) {
+    return std::fwrite(batch.data(), sizeof(Entry), batch.size(), file_) == batch.size() && flushToDisk(file_);
+}
+
+// Checksums are computed here rather than in append() to keep the order
+// path to a copy.
+void OrderJournal::run() {
+    std::vector<Entry> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        pending_cv_.wait(lock, [this] { return !pending_.empty() || !running_; });
+        if (pending_.empty()) {
+            break;
+        }
+        batch.swap(pending_);
+        lock.unlock();
+
+        for (auto& entry : batch) {
+            entry.checksum = checksum(entry);
+        }
+        bool written = !failed_ && writeBatch(batch);
+        uint64_t last = batch.back().sequence;
+        batch.clear();
+
+        lock.lock();
+        if (written) {
+            durable_ = last;
+        } else if (!failed_) {
+            failed_ = true;
+            Logger::log("Order journal write failed; journaling stopped: " + path_);
+        }
+        durable_cv_.notify_all();
+    }
+    durable_cv_.notify_all();
+}
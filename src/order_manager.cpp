@@ -1,13 +1,52 @@
 #include "order_manager.h"
 #include "logger.h"
 #include "api_handler.h"
-#include <json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <sstream>
 #include <stdexcept>
+#include <unordered_set>
 
-OrderManager::OrderManager(APIHandler& api_handler) : api_handler_(api_handler) {}
+namespace {
 
-std::string OrderManager::placeOrder(const std::string& instrument, double quantity, const std::string& side) {
+bool parseResponse(const std::string& response, Json::Value& jsonData) {
+    Json::CharReaderBuilder readerBuilder;
+    std::istringstream responseStream(response);
+    std::string errors;
+    if (!Json::parseFromStream(readerBuilder, responseStream, &jsonData, &errors)) {
+        Logger::log("Error parsing order response: " + errors);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+// Client ids start from the wall clock so labels stay unique across restarts.
+OrderManager::OrderManager(APIHandler& api_handler)
+    : api_handler_(api_handler),
+      next_client_id_(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::system_clock::now().time_since_epoch()).count()) << 20) {}
+
+void OrderManager::setRiskEngine(RiskEngine* risk) {
+    risk_ = risk;
+}
+
+void OrderManager::addFillListener(FillListener listener) {
+    fill_listeners_.push_back(std::move(listener));
+}
+
+void OrderManager::setJournal(OrderJournal* journal) {
+    journal_ = journal;
+}
+
+int64_t OrderManager::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string OrderManager::placeOrder(const std::string& instrument, double quantity, const std::string& side, double price) {
     try {
         Logger::log("Placing order through API...");
 
@@ -21,36 +60,203 @@ std::string OrderManager::placeOrder(const std::string& instrument, double quant
             throw std::invalid_argument("Side must be either 'buy' or 'sell'.");
         }
 
-        std::string response = api_handler_.placeOrder(instrument, quantity, side);
-        if (response.empty()) {
-            Logger::log("Failed to place order: Empty response from API.");
-            return "";
+        Side order_side = side == "buy" ? Side::Bid : Side::Ask;
+        if (risk_) {
+            RiskResult risk = risk_->check(risk_->find(instrument), order_side, quantity, price, nowMs());
+            if (risk != RiskResult::Accepted) {
+                Logger::log("Order rejected by risk check: " + std::string(toString(risk)));
+                return "";
+            }
         }
 
-        // Extract order ID from the response if available
-        std::string order_id = "order_unknown"; // Default if parsing fails
-        Json::Value jsonData;
-        Json::CharReaderBuilder readerBuilder;
-        std::istringstream responseStream(response);
-        std::string errors;
+        uint32_t shard = shardOf(instrument);
+        uint64_t client_id = ++next_client_id_;
+        {
+            std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+            OrderStateCache& orders = shards_[shard].orders;
+            if (orders.size() >= kPurgeThreshold) {
+                orders.purgeTerminal([this](const OrderRecord& record) {
+                    if (record.exchange_id[0] != '\0') {
+                        Stripe& stripe = stripeOf(record.exchangeId());
+                        std::lock_guard<std::mutex> stripe_lock(stripe.mutex);
+                        stripe.shards.erase(record.exchangeId());
+                    }
+                });
+            }
+            OrderRecord* record = orders.insert(client_id, instrument, order_side, quantity, price);
+            if (!record) {
+                if (risk_) {
+                    risk_->onOrderDone(risk_->find(instrument), order_side, quantity);
+                }
+                throw std::invalid_argument("Instrument name is too long.");
+            }
+            record->amend_flags |= OrderRecord::kPlaceInFlight;
+            if (journal_) {
+                journal_->append(JournalEvent::Intent, *record);
+            }
+        }
 
-        if (Json::parseFromStream(readerBuilder, responseStream, &jsonData, &errors)) {
-            if (jsonData.isMember("result") && jsonData["result"].isMember("order") && jsonData["result"]["order"].isMember("order_id")) {
-                order_id = jsonData["result"]["order"]["order_id"].asString();  // Correct path to order_id
+        std::string label = OrderStateCache::label(client_id);
+        std::string response = api_handler_.placeOrder(instrument, quantity, side, label, price);
+        Json::Value jsonData;
+        bool parsed = !response.empty() && parseResponse(response, jsonData) && jsonData.isObject();
+        bool has_order = parsed && jsonData["result"].isObject() && jsonData["result"].isMember("order");
+        {
+            std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+            OrderStateCache& orders = shards_[shard].orders;
+            OrderRecord* record = orders.find(client_id);
+            if (!record) {
+                return "";
+            }
+            record->amend_flags &= static_cast<uint8_t>(~OrderRecord::kPlaceInFlight);
+            if (has_order && applyOrderUpdate(shard, jsonData["result"]["order"])) {
+                record = orders.find(client_id);
+                std::string order_id(record->exchangeId());
+                Logger::log("Order placed successfully: " + order_id + " (" + toString(record->state) + ")");
+                return order_id;
+            }
+            if (parsed && jsonData.isMember("error")) {
+                Logger::log("Order rejected: " + jsonData["error"].get("message", "").asString());
+                OrderState state_before = record->state;
+                orders.transition(*record, OrderState::Rejected);
+                publishChanges(*record, record->filled, record->average_price, state_before);
+                return "";
             }
-        } else {
-            Logger::log("Error parsing order response: " + errors);
         }
 
-        active_orders_[order_id] = instrument;
-        Logger::log("Order placed successfully: " + order_id);
-        return order_id;
+        // No usable reply: the order may still have reached the exchange, so
+        // it stays New until found under its label here, on the user stream
+        // or by reconciliation.
+        Logger::log("No order in reply to " + label + "; looking it up by label.");
+        bool absent = false;
+        if (lookupByLabel(instrument.substr(0, instrument.find_first_of("-_")), client_id, absent)) {
+            std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+            if (const OrderRecord* record = shards_[shard].orders.find(client_id)) {
+                std::string order_id(record->exchangeId());
+                Logger::log("Order placed: " + order_id + " (" + toString(record->state) + ")");
+                return order_id;
+            }
+        }
+        Logger::log("Order " + label + " is unconfirmed; left open until the exchange reports it.");
+        return "";
     } catch (const std::exception& e) {
         Logger::log("Error placing order: " + std::string(e.what()));
         return "";
     }
 }
 
+uint32_t OrderManager::shardOf(std::string_view instrument) const {
+    return static_cast<uint32_t>(std::hash<std::string_view>{}(instrument) % kShards);
+}
+
+// High hash bits pick the stripe; the stripe's table probes from the low ones.
+OrderManager::Stripe& OrderManager::stripeOf(std::string_view order_id) const {
+    return stripes_[(ExchangeIdIndex::hash(order_id) >> 32) % kStripes];
+}
+
+uint32_t OrderManager::shardOfOrder(const std::string& order_id) const {
+    Stripe& stripe = stripeOf(order_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    uint32_t shard = 0;
+    return stripe.shards.find(order_id, shard) ? shard : static_cast<uint32_t>(kShards);
+}
+
+bool OrderManager::applyOrderUpdate(const Json::Value& order) {
+    if (!order.isObject()) {
+        return false;
+    }
+    uint32_t shard = order.isMember("instrument_name") ? shardOf(order["instrument_name"].asString())
+                                                       : shardOfOrder(order.get("order_id", "").asString());
+    if (shard >= kShards) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+    return applyOrderUpdate(shard, order);
+}
+
+bool OrderManager::applyOrderUpdate(uint32_t shard, const Json::Value& order) {
+    if (!order.isObject()) {
+        return false;
+    }
+    OrderStateCache& orders = shards_[shard].orders;
+    std::string order_id = order.get("order_id", "").asString();
+    OrderRecord* record = nullptr;
+    if (uint64_t client_id = OrderStateCache::parseLabel(order.get("label", "").asString())) {
+        record = orders.find(client_id);
+    }
+    if (!record) {
+        record = orders.findByExchangeId(order_id);
+    }
+    if (!record) {
+        return false;
+    }
+
+    double filled_before = record->filled;
+    double average_before = record->average_price;
+    OrderState state_before = record->state;
+    double filled = order.get("filled_amount", 0.0).asDouble();
+    OrderState state = orderStateFromExchange(order.get("order_state", "").asString(), filled);
+    if (order.isMember("amount") && order["amount"].isNumeric()) {
+        record->quantity = order["amount"].asDouble();
+    }
+    if (order.isMember("price") && order["price"].isNumeric()) {
+        record->price = order["price"].asDouble();
+    }
+    if (state == OrderState::Rejected) {
+        bool moved = orders.transition(*record, state);
+        publishChanges(*record, filled_before, average_before, state_before);
+        return moved;
+    }
+    bool indexed = record->exchange_id[0] != '\0';
+    if (order_id.empty() || !orders.acknowledge(*record, order_id)) {
+        return false;
+    }
+    if (!indexed) {
+        Stripe& stripe = stripeOf(order_id);
+        std::lock_guard<std::mutex> stripe_lock(stripe.mutex);
+        stripe.shards.insert(order_id, shard);
+    }
+    double average_price = order.get("average_price", 0.0).isNumeric() ? order.get("average_price", 0.0).asDouble() : 0.0;
+    orders.applyFill(*record, filled, average_price);
+    if (!orders.transition(*record, state)) {
+        Logger::log("Ignoring order " + order_id + " moving from " + toString(record->state) + " to " + toString(state));
+    }
+    publishChanges(*record, filled_before, average_before, state_before);
+    return true;
+}
+
+void OrderManager::publishChanges(const OrderRecord& record, double filled_before, double average_before,
+                                  OrderState state_before) {
+    if (journal_) {
+        JournalEvent event = JournalEvent::Amend;
+        if (record.filled > filled_before) {
+            event = JournalEvent::Fill;
+        } else if (record.state != state_before) {
+            event = record.state == OrderState::Cancelled  ? JournalEvent::Cancel
+                    : record.state == OrderState::Rejected ? JournalEvent::Reject
+                                                           : JournalEvent::Ack;
+        }
+        journal_->append(event, record);
+    }
+    if (record.filled > filled_before) {
+        double quantity = record.filled - filled_before;
+        // The exchange reports a running average, so the new fills' price is what moved it.
+        double price = record.average_price > 0.0
+                           ? (record.average_price * record.filled - average_before * filled_before) / quantity
+                           : record.price;
+        if (risk_) {
+            risk_->onFill(risk_->find(std::string(record.instrumentName())), record.side, quantity);
+        }
+        for (const auto& listener : fill_listeners_) {
+            listener(record, quantity, price);
+        }
+    }
+    if (risk_ && isTerminal(record.state) && !isTerminal(state_before)) {
+        risk_->onOrderDone(risk_->find(std::string(record.instrumentName())), record.side,
+                           std::max(record.quantity - record.filled, 0.0));
+    }
+}
+
 bool OrderManager::cancelOrder(const std::string& order_id) {
     try {
         Logger::log("Cancelling order through API...");
@@ -59,25 +265,175 @@ bool OrderManager::cancelOrder(const std::string& order_id) {
             throw std::invalid_argument("Order ID is empty.");
         }
 
-        bool success = api_handler_.cancelOrder(order_id);
-        if (!success) {
-            Logger::log("Failed to cancel order: API request unsuccessful.");
+        // The cancel supersedes any queued edit, and no new ones are queued behind it.
+        uint32_t shard = shardOfOrder(order_id);
+        if (shard < kShards) {
+            std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+            if (OrderRecord* record = shards_[shard].orders.findByExchangeId(order_id)) {
+                record->amend_flags = static_cast<uint8_t>(
+                    (record->amend_flags & ~OrderRecord::kAmendQueued) | OrderRecord::kCancelRequested);
+            }
+        }
+
+        // The order's state is taken from the reply, which carries any fills
+        // that beat the cancel. An error (already filled, not found) leaves
+        // it to the order's own updates.
+        std::string response = api_handler_.cancelOrder(order_id);
+        Json::Value jsonData;
+        if (response.empty() || !parseResponse(response, jsonData) || !jsonData["result"].isObject()) {
+            Logger::log("Failed to cancel order " + order_id + ": " +
+                        (jsonData.isMember("error") ? jsonData["error"].get("message", "").asString()
+                                                    : std::string("no order in API response.")));
+            if (shard < kShards) {
+                std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+                if (OrderRecord* record = shards_[shard].orders.findByExchangeId(order_id)) {
+                    record->amend_flags &= static_cast<uint8_t>(~OrderRecord::kCancelRequested);
+                }
+            }
             return false;
         }
 
-        if (active_orders_.erase(order_id)) {
+        if (applyOrderUpdate(jsonData["result"])) {
             Logger::log("Order canceled successfully: " + order_id);
-            return true;
         } else {
             Logger::log("Order canceled but not found in active orders: " + order_id);
-            return true; // Still successful, but not tracked
         }
+        return true; // Still successful if not tracked
     } catch (const std::exception& e) {
         Logger::log("Error cancelling order: " + std::string(e.what()));
         return false;
     }
 }
 
+void OrderManager::setMaxInFlight(size_t max_in_flight) {
+    max_in_flight_ = std::max<size_t>(max_in_flight, 1);
+}
+
+size_t OrderManager::maxInFlight() const {
+    return max_in_flight_;
+}
+
+// Every REST request is its own connection, so in-flight requests are
+// bounded by the number of workers; each takes the next unclaimed index.
+void OrderManager::dispatch(size_t count, const std::function<void(size_t)>& task) {
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            task(i);
+        }
+    };
+    size_t threads = std::min(count, max_in_flight_.load());
+    std::vector<std::thread> workers;
+    workers.reserve(threads > 0 ? threads - 1 : 0);
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+BatchResult OrderManager::placeOrders(const std::vector<OrderRequest>& orders) {
+    BatchResult result;
+    result.succeeded.assign(orders.size(), false);
+    result.order_ids.assign(orders.size(), "");
+    std::vector<char> placed(orders.size(), 0);  // written concurrently, unlike vector<bool>
+    dispatch(orders.size(), [&](size_t i) {
+        result.order_ids[i] = placeOrder(orders[i].instrument, orders[i].quantity, orders[i].side, orders[i].price);
+        placed[i] = !result.order_ids[i].empty();
+    });
+    for (size_t i = 0; i < orders.size(); ++i) {
+        result.succeeded[i] = placed[i] != 0;
+        result.accepted += placed[i] != 0;
+    }
+    Logger::log("Placed " + std::to_string(result.accepted) + "/" + std::to_string(orders.size()) + " orders.");
+    return result;
+}
+
+BatchResult OrderManager::modifyOrders(const std::vector<OrderAmend>& amends) {
+    BatchResult result;
+    result.succeeded.assign(amends.size(), false);
+    std::vector<char> modified(amends.size(), 0);
+    dispatch(amends.size(), [&](size_t i) {
+        modified[i] = modifyOrder(amends[i].order_id, amends[i].quantity, amends[i].price);
+    });
+    for (size_t i = 0; i < amends.size(); ++i) {
+        result.succeeded[i] = modified[i] != 0;
+        result.accepted += modified[i] != 0;
+    }
+    Logger::log("Modified " + std::to_string(result.accepted) + "/" + std::to_string(amends.size()) + " orders.");
+    return result;
+}
+
+BatchResult OrderManager::cancelOrders(const std::vector<std::string>& order_ids) {
+    BatchResult result;
+    result.succeeded.assign(order_ids.size(), false);
+    std::vector<char> cancelled(order_ids.size(), 0);
+    dispatch(order_ids.size(), [&](size_t i) {
+        cancelled[i] = cancelOrder(order_ids[i]);
+    });
+    for (size_t i = 0; i < order_ids.size(); ++i) {
+        result.succeeded[i] = cancelled[i] != 0;
+        result.accepted += cancelled[i] != 0;
+    }
+    Logger::log("Cancelled " + std::to_string(result.accepted) + "/" + std::to_string(order_ids.size()) + " orders.");
+    return result;
+}
+
+bool OrderManager::cancelAll() {
+    return finishMassCancel(api_handler_.cancelAll());
+}
+
+bool OrderManager::cancelAllByInstrument(const std::string& instrument) {
+    return finishMassCancel(api_handler_.cancelAllByInstrument(instrument));
+}
+
+bool OrderManager::cancelAllByCurrency(const std::string& currency) {
+    return finishMassCancel(api_handler_.cancelAllByCurrency(currency));
+}
+
+// Instruments of a currency are named "{currency}-..." or "{currency}_...".
+bool OrderManager::inCurrency(std::string_view instrument, const std::string& currency) {
+    return instrument.size() > currency.size() && instrument.compare(0, currency.size(), currency) == 0 &&
+           (instrument[currency.size()] == '-' || instrument[currency.size()] == '_');
+}
+
+// Only what the exchange says it cancelled is marked: an order that filled
+// first, or was still on its way, keeps its state until its own update.
+bool OrderManager::finishMassCancel(const std::string& response) {
+    Json::Value jsonData;
+    if (response.empty() || !parseResponse(response, jsonData) || !jsonData.isMember("result")) {
+        Logger::log("Mass cancel failed.");
+        return false;
+    }
+    if (jsonData["result"].isNumeric()) {
+        Logger::log("Mass cancel: exchange cancelled " + std::to_string(jsonData["result"].asInt64()) +
+                    " orders; their updates follow on the user stream.");
+        return true;
+    }
+    size_t applied = applyCancelledOrders(jsonData["result"]);
+    Logger::log("Mass cancel: " + std::to_string(applied) + " tracked orders cancelled.");
+    return true;
+}
+
+size_t OrderManager::applyCancelledOrders(const Json::Value& value) {
+    if (value.isArray()) {
+        size_t applied = 0;
+        for (const auto& item : value) {
+            applied += applyCancelledOrders(item);
+        }
+        return applied;
+    }
+    if (!value.isObject()) {
+        return 0;
+    }
+    if (value.isMember("order_id")) {
+        return applyOrderUpdate(value) ? 1 : 0;
+    }
+    return value.isMember("result") ? applyCancelledOrders(value["result"]) : 0;
+}
+
 std::string OrderManager::getPosition(const std::string& currency, std::string kind) {
     try
     {
@@ -100,7 +456,10 @@ std::string OrderManager::getPosition(const std::string& currency, std::string k
     
 }
 
-bool OrderManager::modifyOrder(const std::string& order_id, double new_quantity) {
+// The caller whose edit is in flight keeps sending the latest queued state
+// after each reply until nothing is queued. Orders we do not track are
+// edited directly.
+bool OrderManager::modifyOrder(const std::string& order_id, double new_quantity, double new_price) {
     try {
         Logger::log("Modifying order through API...");
 
@@ -110,34 +469,278 @@ bool OrderManager::modifyOrder(const std::string& order_id, double new_quantity)
         if (new_quantity <= 0) {
             throw std::invalid_argument("New quantity must be greater than zero.");
         }
-         std::string response = api_handler_.modifyOrder(order_id, new_quantity); // Assuming "buy" for simplicity
-        if (response.empty()) {
-            Logger::log("Failed to place order: Empty response from API.");
-            return "";
+
+        uint32_t shard = shardOfOrder(order_id);
+        OrderRecord current;
+        bool tracked = false;
+        if (shard < kShards) {
+            std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+            if (OrderRecord* record = shards_[shard].orders.findByExchangeId(order_id)) {
+                if (isTerminal(record->state) || (record->amend_flags & OrderRecord::kCancelRequested)) {
+                    Logger::log("Not modifying order " + order_id + ": it is " +
+                                (isTerminal(record->state) ? toString(record->state) : "being cancelled") + ".");
+                    return false;
+                }
+                if (record->amend_flags & OrderRecord::kAmendInFlight) {
+                    record->pending_quantity = new_quantity;
+                    record->pending_price = new_price;
+                    record->amend_flags |= OrderRecord::kAmendQueued;
+                    Logger::log("Edit of order " + order_id + " queued behind the one in flight.");
+                    return true;
+                }
+                record->amend_flags |= OrderRecord::kAmendInFlight;
+                current = *record;
+                tracked = true;
+            }
+        }
+        if (!tracked) {
+            return sendAmend(order_id, nullptr, new_quantity, new_price);
         }
 
-        // Extract order ID from the response if available
-        std::string order_id = "order_unknown"; // Default if parsing fails
-        Json::Value jsonData;
-        Json::CharReaderBuilder readerBuilder;
-        std::istringstream responseStream(response);
-        std::string errors;
+        // Clears the in-flight edit if an exception leaves the loop, or every
+        // later edit of the order would be queued and never sent.
+        struct InFlight {
+            OrderManager* manager;
+            uint32_t shard;
+            const std::string& order_id;
+            bool armed = true;
+            ~InFlight() {
+                if (!armed) {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(manager->shards_[shard].mutex);
+                if (OrderRecord* record = manager->shards_[shard].orders.findByExchangeId(order_id)) {
+                    record->amend_flags &=
+                        static_cast<uint8_t>(~(OrderRecord::kAmendInFlight | OrderRecord::kAmendQueued));
+                }
+            }
+        } in_flight{this, shard, order_id};
 
-        if (Json::parseFromStream(readerBuilder, responseStream, &jsonData, &errors)) {
-            if (jsonData.isMember("result") && jsonData["result"].isMember("order") && jsonData["result"]["order"].isMember("order_id")) {
-                order_id = jsonData["result"]["order"]["order_id"].asString();  // Correct path to order_id
+        bool first = true;
+        bool result = false;
+        while (true) {
+            bool amended = sendAmend(order_id, &current, new_quantity, new_price);
+            if (first) {
+                result = amended;
+                first = false;
+            } else if (!amended) {
+                Logger::log("Queued edit of order " + order_id + " failed.");
             }
-        } else {
-            Logger::log("Error parsing order response: " + errors);
+
+            std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+            OrderRecord* record = shards_[shard].orders.findByExchangeId(order_id);
+            if (!record) {
+                in_flight.armed = false;
+                return result;
+            }
+            bool queued = (record->amend_flags & OrderRecord::kAmendQueued) && !isTerminal(record->state) &&
+                          !(record->amend_flags & OrderRecord::kCancelRequested);
+            record->amend_flags &= static_cast<uint8_t>(~OrderRecord::kAmendQueued);
+            if (!queued) {
+                record->amend_flags &= static_cast<uint8_t>(~OrderRecord::kAmendInFlight);
+                in_flight.armed = false;
+                return result;
+            }
+            new_quantity = record->pending_quantity;
+            new_price = record->pending_price;
+            current = *record;
+        }
+    } catch (const std::exception& e) {
+        Logger::log("Error modifying order: " + std::string(e.what()));
+        return false;
+    }
+}
+
+// current is the order as we hold it, or null if it is not tracked.
+bool OrderManager::sendAmend(const std::string& order_id, const OrderRecord* current, double new_quantity,
+                             double new_price) {
+    uint32_t risk_id = UINT32_MAX;
+    if (risk_ && current) {
+        risk_id = risk_->find(std::string(current->instrumentName()));
+        RiskResult risk = risk_->checkAmend(risk_id, current->side, current->quantity, new_quantity,
+                                            new_price > 0.0 ? new_price : current->price, nowMs());
+        if (risk != RiskResult::Accepted) {
+            Logger::log("Amend rejected by risk check: " + std::string(toString(risk)));
+            return false;
+        }
+    }
+    auto settle = [&](bool amended) {
+        if (risk_id != UINT32_MAX) {
+            double reserved = new_quantity - current->quantity;
+            if (reserved < 0.0 ? amended : !amended) {
+                risk_->release(risk_id, current->side, std::fabs(reserved));
+            }
+        }
+        return amended;
+    };
+
+    std::string response = api_handler_.modifyOrder(order_id, new_quantity, new_price);
+    if (response.empty()) {
+        Logger::log("Failed to modify order: Empty response from API.");
+        return settle(false);
+    }
+
+    Json::Value jsonData;
+    if (!parseResponse(response, jsonData) || !jsonData.isObject() || !jsonData["result"].isObject() ||
+        !jsonData["result"].isMember("order")) {
+        Logger::log("Failed to modify order " + order_id + ": no order in API response.");
+        return settle(false);
+    }
+    const Json::Value& order = jsonData["result"]["order"];
+    if (!applyOrderUpdate(order)) {
+        Logger::log("Order modified but not found in active orders: " + order_id);
+    }
+    Logger::log("Order modified successfully: " + order.get("order_id", order_id).asString());
+    return settle(true);
+}
+
+bool OrderManager::getOrder(const std::string& order_id, OrderRecord& order) const {
+    uint32_t shard = shardOfOrder(order_id);
+    if (shard >= kShards) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+    const OrderRecord* record = shards_[shard].orders.findByExchangeId(order_id);
+    if (!record) {
+        return false;
+    }
+    order = *record;
+    return true;
+}
+
+std::vector<OrderRecord> OrderManager::openOrders() const {
+    std::vector<OrderRecord> open;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.orders.forEach([&open](const OrderRecord& record) {
+            if (!isTerminal(record.state)) {
+                open.push_back(record);
+            }
+        });
+    }
+    return open;
+}
+
+size_t OrderManager::restore(const std::vector<OrderRecord>& orders) {
+    size_t restored = 0;
+    uint64_t max_client_id = 0;
+    for (const auto& order : orders) {
+        if (isTerminal(order.state)) {
+            continue;
+        }
+        uint32_t shard = shardOf(order.instrumentName());
+        std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+        OrderStateCache& cache = shards_[shard].orders;
+        OrderRecord* record = cache.insert(order.client_id, order.instrumentName(), order.side, order.quantity, order.price);
+        if (!record) {
+            continue;
         }
-        if (order_id != "order_unknown") {
-            Logger::log("Order modified successfully: " + order_id);
-            return true;
+        if (order.exchange_id[0] != '\0' && cache.acknowledge(*record, order.exchangeId())) {
+            Stripe& stripe = stripeOf(order.exchangeId());
+            std::lock_guard<std::mutex> stripe_lock(stripe.mutex);
+            stripe.shards.insert(order.exchangeId(), shard);
         }
+        record->filled = order.filled;
+        record->average_price = order.average_price;
+        record->state = order.state;
+        if (risk_) {
+            risk_->onOrderRestored(risk_->find(std::string(order.instrumentName())), order.side,
+                                   std::max(order.quantity - order.filled, 0.0));
+        }
+        max_client_id = std::max(max_client_id, order.client_id);
+        ++restored;
+    }
+    uint64_t next = next_client_id_.load();
+    while (next < max_client_id && !next_client_id_.compare_exchange_weak(next, max_client_id)) {
+    }
+    Logger::log("Restored " + std::to_string(restored) + " orders from the journal.");
+    return restored;
+}
+
+size_t OrderManager::reconcileOpenOrders(const std::string& currency) {
+    std::string response = api_handler_.getOpenOrders(currency);
+    Json::Value jsonData;
+    if (response.empty() || !parseResponse(response, jsonData) || !jsonData["result"].isArray()) {
+        Logger::log("Failed to fetch open " + currency + " orders for reconciliation.");
+        return 0;
+    }
+    std::unordered_set<uint64_t> open;  // client ids the exchange still has open
+    for (const auto& order : jsonData["result"]) {
+        applyOrderUpdate(order);
+        uint64_t client_id = OrderStateCache::parseLabel(order.get("label", "").asString());
+        uint32_t shard = shardOfOrder(order.get("order_id", "").asString());
+        if (client_id == 0 && shard < kShards) {
+            std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+            if (const OrderRecord* record = shards_[shard].orders.findByExchangeId(order["order_id"].asString())) {
+                client_id = record->client_id;
+            }
+        }
+        if (client_id != 0) {
+            open.insert(client_id);
+        }
+    }
+
+    // The rest finished, or never reached the exchange, while we were down.
+    struct Missing {
+        std::string order_id;  // "" if never acknowledged: looked up by label
+        uint64_t client_id;
+        uint32_t shard;
+    };
+    std::vector<Missing> missing;
+    for (uint32_t shard = 0; shard < kShards; ++shard) {
+        std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+        shards_[shard].orders.forEach([&](const OrderRecord& record) {
+            if (!isTerminal(record.state) && !(record.amend_flags & OrderRecord::kPlaceInFlight) &&
+                !open.count(record.client_id) && inCurrency(record.instrumentName(), currency)) {
+                missing.push_back({std::string(record.exchangeId()), record.client_id, shard});
+            }
+        });
+    }
+
+    std::vector<char> resolved(missing.size(), 0);
+    dispatch(missing.size(), [&](size_t i) {
+        Json::Value reply;
+        if (!missing[i].order_id.empty()) {
+            std::string state = api_handler_.getOrderState(missing[i].order_id);
+            resolved[i] = !state.empty() && parseResponse(state, reply) && applyOrderUpdate(reply["result"]);
+            return;
+        }
+        bool absent = false;
+        resolved[i] = lookupByLabel(currency, missing[i].client_id, absent);
+        if (absent) {
+            resolved[i] = rejectUnsent(missing[i].shard, missing[i].client_id);
+        }
+    });
+    size_t updated = static_cast<size_t>(std::count(resolved.begin(), resolved.end(), 1));
+    Logger::log("Reconciled " + currency + " orders: " + std::to_string(open.size()) + " open, " +
+                std::to_string(updated) + "/" + std::to_string(missing.size()) + " others updated.");
+    return missing.size();
+}
+
+bool OrderManager::lookupByLabel(const std::string& currency, uint64_t client_id, bool& absent) {
+    absent = false;
+    Json::Value reply;
+    std::string state = api_handler_.getOrderStateByLabel(currency, OrderStateCache::label(client_id));
+    if (state.empty() || !parseResponse(state, reply) || !reply.isObject() || !reply["result"].isArray()) {
+        return false;
+    }
+    bool applied = false;
+    for (const auto& order : reply["result"]) {
+        applied |= applyOrderUpdate(order);
+    }
+    absent = reply["result"].empty();
+    return applied;
+}
+
+// The exchange has no order with this client id's label.
+bool OrderManager::rejectUnsent(uint32_t shard, uint64_t client_id) {
+    std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+    OrderRecord* record = shards_[shard].orders.find(client_id);
+    if (!record || isTerminal(record->state)) {
         return false;
-        
-    } catch (const std::exception& e) {
-        Logger::log("Error placing order: " + std::string(e.what()));
-        return "";
     }
+    OrderState state_before = record->state;
+    bool moved = shards_[shard].orders.transition(*record, OrderState::Rejected);
+    publishChanges(*record, record->filled, record->average_price, state_before);
+    return moved;
 }
@@ -0,0 +1,370 @@
+#include "order_state_cache.h"
+#include <cstring>
+
+namespace {
+
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t hashId(std::string_view id) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : id) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+    }
+    return hash | 1;  // never 0
+}
+
+bool copyName(char* out, size_t max, std::string_view name) {
+    if (name.size() > max) {
+        return false;
+    }
+    std::memcpy(out, name.data(), name.size());
+    out[name.size()] = '\0';
+    return true;
+}
+
+// Whether an entry whose home slot is home may move back into hole without
+// leaving its probe path (linear probing, wrap-around aware).
+bool canShift(size_t home, size_t hole, size_t entry) {
+    return entry > hole ? (home <= hole || home > entry) : (home <= hole && home > entry);
+}
+
+constexpr std::string_view kLabelPrefix = "oc-";
+
+}  // namespace
+
+const char* toString(OrderState state) {
+    switch (state) {
+    case OrderState::New: return "new";
+    case OrderState::Acked: return "acked";
+    case OrderState::PartiallyFilled: return "partially_filled";
+    case OrderState::Filled: return "filled";
+    case OrderState::Cancelled: return "cancelled";
+    case OrderState::Rejected: return "rejected";
+    }
+    return "unknown";
+}
+
+bool isTerminal(OrderState state) {
+    return state == OrderState::Filled || state == OrderState::Cancelled || state == OrderState::Rejected;
+}
+
+bool canTransition(OrderState from, OrderState to) {
+    switch (from) {
+    case OrderState::New:
+        return to != OrderState::New;
+    case OrderState::Acked:
+        return to == OrderState::PartiallyFilled || to == OrderState::Filled || to == OrderState::Cancelled;
+    case OrderState::PartiallyFilled:
+        return to == OrderState::PartiallyFilled || to == OrderState::Filled || to == OrderState::Cancelled;
+    default:
+        return false;
+    }
+}
+
+OrderState orderStateFromExchange(std::string_view order_state, double filled_amount) {
+    if (order_state == "filled") {
+        return OrderState::Filled;
+    }
+    if (order_state == "cancelled") {
+        return OrderState::Cancelled;
+    }
+    if (order_state == "rejected") {
+        return OrderState::Rejected;
+    }
+    return filled_amount > 0.0 ? OrderState::PartiallyFilled : OrderState::Acked;
+}
+
+ExchangeIdIndex::ExchangeIdIndex(size_t capacity) {
+    size_t size = 16;
+    while (size < capacity * 2) {
+        size <<= 1;
+    }
+    slots_.resize(size);
+    mask_ = size - 1;
+}
+
+uint64_t ExchangeIdIndex::hash(std::string_view exchange_id) {
+    return hashId(exchange_id);
+}
+
+size_t ExchangeIdIndex::slotOf(uint64_t hash, std::string_view exchange_id) const {
+    size_t slot = hash & mask_;
+    while (slots_[slot].hash != 0 && (slots_[slot].hash != hash || exchange_id != slots_[slot].id)) {
+        slot = (slot + 1) & mask_;
+    }
+    return slot;
+}
+
+bool ExchangeIdIndex::insert(std::string_view exchange_id, uint32_t value) {
+    if (exchange_id.empty() || exchange_id.size() > OrderRecord::kMaxExchangeId) {
+        return false;
+    }
+    if ((size_ + 1) * 2 > slots_.size()) {
+        grow();
+    }
+    uint64_t hash = hashId(exchange_id);
+    Slot& slot = slots_[slotOf(hash, exchange_id)];
+    if (slot.hash == 0) {
+        slot.hash = hash;
+        copyName(slot.id, OrderRecord::kMaxExchangeId, exchange_id);
+        ++size_;
+    }
+    slot.value = value;
+    return true;
+}
+
+bool ExchangeIdIndex::find(std::string_view exchange_id, uint32_t& value) const {
+    const Slot& slot = slots_[slotOf(hashId(exchange_id), exchange_id)];
+    if (slot.hash == 0) {
+        return false;
+    }
+    value = slot.value;
+    return true;
+}
+
+bool ExchangeIdIndex::erase(std::string_view exchange_id) {
+    size_t hole = slotOf(hashId(exchange_id), exchange_id);
+    if (slots_[hole].hash == 0) {
+        return false;
+    }
+    for (size_t slot = (hole + 1) & mask_; slots_[slot].hash != 0; slot = (slot + 1) & mask_) {
+        if (canShift(slots_[slot].hash & mask_, hole, slot)) {
+            slots_[hole] = slots_[slot];
+            hole = slot;
+        }
+    }
+    slots_[hole] = Slot{};
+    --size_;
+    return true;
+}
+
+void ExchangeIdIndex::grow() {
+    std::vector<Slot> slots;
+    slots.swap(slots_);
+    slots_.resize(slots.size() * 2);
+    mask_ = slots_.size() - 1;
+    for (const auto& slot : slots) {
+        if (slot.hash != 0) {
+            slots_[slotOf(slot.hash, slot.id)] = slot;
+        }
+    }
+}
+
+OrderStateCache::OrderStateCache(size_t capacity) {
+    size_t size = 16;
+    while (size < capacity * 2) {
+        size <<= 1;
+    }
+    records_.resize(size);
+    by_exchange_id_.resize(size);
+    mask_ = size - 1;
+}
+
+size_t OrderStateCache::slotOf(uint64_t client_id) const {
+    size_t slot = mix(client_id) & mask_;
+    while (records_[slot].client_id != 0 && records_[slot].client_id != client_id) {
+        slot = (slot + 1) & mask_;
+    }
+    return slot;
+}
+
+size_t OrderStateCache::exchangeSlotOf(uint64_t hash, std::string_view exchange_id) const {
+    size_t slot = hash & mask_;
+    while (by_exchange_id_[slot].client_id != 0) {
+        if (by_exchange_id_[slot].hash == hash) {
+            const OrderRecord& record = records_[slotOf(by_exchange_id_[slot].client_id)];
+            if (record.exchangeId() == exchange_id) {
+                break;
+            }
+        }
+        slot = (slot + 1) & mask_;
+    }
+    return slot;
+}
+
+OrderRecord* OrderStateCache::insert(uint64_t client_id, std::string_view instrument, Side side,
+                                     double quantity, double price) {
+    if (client_id == 0 || instrument.size() > OrderRecord::kMaxInstrument) {
+        return nullptr;
+    }
+    if ((size_ + 1) * 2 > records_.size()) {
+        grow();
+    }
+    size_t slot = slotOf(client_id);
+    if (records_[slot].client_id != 0) {
+        return nullptr;
+    }
+    OrderRecord& record = records_[slot];
+    record = OrderRecord{};
+    record.client_id = client_id;
+    record.side = side;
+    record.quantity = quantity;
+    record.price = price;
+    copyName(record.instrument, OrderRecord::kMaxInstrument, instrument);
+    ++size_;
+    return &record;
+}
+
+OrderRecord* OrderStateCache::find(uint64_t client_id) {
+    size_t slot = slotOf(client_id);
+    return records_[slot].client_id == 0 ? nullptr : &records_[slot];
+}
+
+const OrderRecord* OrderStateCache::find(uint64_t client_id) const {
+    size_t slot = slotOf(client_id);
+    return records_[slot].client_id == 0 ? nullptr : &records_[slot];
+}
+
+OrderRecord* OrderStateCache::findByExchangeId(std::string_view exchange_id) {
+    return const_cast<OrderRecord*>(static_cast<const OrderStateCache&>(*this).findByExchangeId(exchange_id));
+}
+
+const OrderRecord* OrderStateCache::findByExchangeId(std::string_view exchange_id) const {
+    if (exchange_id.empty()) {
+        return nullptr;
+    }
+    size_t slot = exchangeSlotOf(hashId(exchange_id), exchange_id);
+    return by_exchange_id_[slot].client_id == 0 ? nullptr : find(by_exchange_id_[slot].client_id);
+}
+
+bool OrderStateCache::acknowledge(OrderRecord& record, std::string_view exchange_id) {
+    if (record.exchange_id[0] == '\0') {
+        if (!copyName(record.exchange_id, OrderRecord::kMaxExchangeId, exchange_id)) {
+            return false;
+        }
+        indexExchangeId(record);
+    }
+    return record.state == OrderState::New ? transition(record, OrderState::Acked) : true;
+}
+
+bool OrderStateCache::transition(OrderRecord& record, OrderState state) {
+    if (record.state == state && state != OrderState::PartiallyFilled) {
+        return true;
+    }
+    if (!canTransition(record.state, state)) {
+        return false;
+    }
+    record.state = state;
+    return true;
+}
+
+bool OrderStateCache::applyFill(OrderRecord& record, double filled, double average_price) {
+    if (filled < record.filled || isTerminal(record.state)) {
+        return filled == record.filled;
+    }
+    OrderState next = filled >= record.quantity ? OrderState::Filled : OrderState::PartiallyFilled;
+    if (filled > 0.0 && !transition(record, next)) {
+        return false;
+    }
+    record.filled = filled;
+    record.average_price = average_price;
+    return true;
+}
+
+void OrderStateCache::indexExchangeId(const OrderRecord& record) {
+    uint64_t hash = hashId(record.exchangeId());
+    size_t slot = exchangeSlotOf(hash, record.exchangeId());
+    by_exchange_id_[slot] = {hash, record.client_id};
+}
+
+void OrderStateCache::unindexExchangeId(const OrderRecord& record) {
+    if (record.exchange_id[0] == '\0') {
+        return;
+    }
+    size_t hole = exchangeSlotOf(hashId(record.exchangeId()), record.exchangeId());
+    if (by_exchange_id_[hole].client_id == 0) {
+        return;
+    }
+    for (size_t slot = (hole + 1) & mask_; by_exchange_id_[slot].client_id != 0; slot = (slot + 1) & mask_) {
+        if (canShift(by_exchange_id_[slot].hash & mask_, hole, slot)) {
+            by_exchange_id_[hole] = by_exchange_id_[slot];
+            hole = slot;
+        }
+    }
+    by_exchange_id_[hole] = ExchangeSlot{};
+}
+
+bool OrderStateCache::erase(uint64_t client_id) {
+    size_t hole = slotOf(client_id);
+    if (records_[hole].client_id == 0) {
+        return false;
+    }
+    // The exchange index refers to records by client id, so it is unaffected
+    // by records shifting below.
+    unindexExchangeId(records_[hole]);
+    for (size_t slot = (hole + 1) & mask_; records_[slot].client_id != 0; slot = (slot + 1) & mask_) {
+        if (canShift(mix(records_[slot].client_id) & mask_, hole, slot)) {
+            records_[hole] = records_[slot];
+            hole = slot;
+        }
+    }
+    records_[hole] = OrderRecord{};
+    --size_;
+    return true;
+}
+
+size_t OrderStateCache::purgeTerminal(const std::function<void(const OrderRecord&)>& on_erase) {
+    std::vector<uint64_t> terminal;
+    for (const auto& record : records_) {
+        if (record.client_id != 0 && isTerminal(record.state)) {
+            terminal.push_back(record.client_id);
+            if (on_erase) {
+                on_erase(record);
+            }
+        }
+    }
+    for (uint64_t client_id : terminal) {
+        erase(client_id);
+    }
+    return terminal.size();
+}
+
+void OrderStateCache::forEach(const std::function<void(const OrderRecord&)>& fn) const {
+    for (const auto& record : records_) {
+        if (record.client_id != 0) {
+            fn(record);
+        }
+    }
+}
+
+void OrderStateCache::grow() {
+    std::vector<OrderRecord> records;
+    records.swap(records_);
+    records_.resize(records.size() * 2);
+    by_exchange_id_.assign(records_.size(), ExchangeSlot{});
+    mask_ = records_.size() - 1;
+    for (const auto& record : records) {
+        if (record.client_id != 0) {
+            records_[slotOf(record.client_id)] = record;
+        }
+    }
+    for (const auto& record : records_) {
+        if (record.client_id != 0 && record.exchange_id[0] != '\0') {
+            indexExchangeId(record);
+        }
+    }
+}
+
+std::string OrderStateCache::label(uint64_t client_id) {
+    return std::string(kLabelPrefix) + std::to_string(client_id);
+}
+
+uint64_t OrderStateCache::parseLabel(std::string_view label) {
+    if (label.substr(0, kLabelPrefix.size()) != kLabelPrefix || label.size() == kLabelPrefix.size()) {
+        return 0;
+    }
+    uint64_t client_id = 0;
+    for (char c : label.substr(kLabelPrefix.size())) {
+        if (c < '0' || c > '9') {
+            return 0;
+        }
+        client_id = client_id * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return client_id;
+}
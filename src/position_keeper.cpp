@@ -0,0 +1,209 @@
+#include "position_keeper.h"
+#include "logger.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kSizeEpsilon = 1e-9;
+
+// Coin-settled futures (BTC-PERPETUAL, BTC-27DEC24) are inverse; options
+// (four dash-separated parts) and USDC/USDT-margined instruments are linear.
+bool isInverse(const std::string& instrument) {
+    return instrument.find('_') == std::string::npos &&
+           std::count(instrument.begin(), instrument.end(), '-') < 3;
+}
+
+// Profit from moving size contracts from entry to exit.
+double pnl(const Position& position, double size, double entry, double exit) {
+    if (entry <= 0.0 || exit <= 0.0) {
+        return 0.0;
+    }
+    return position.inverse ? size * (1.0 / entry - 1.0 / exit) : size * (exit - entry);
+}
+
+void markToMarket(Position& position) {
+    position.unrealized_pnl = pnl(position, position.size, position.average_price, position.mark_price);
+}
+
+Position fromExchange(const nlohmann::json& item) {
+    Position position;
+    position.instrument = item.value("instrument_name", "");
+    position.size = item.value("size", 0.0);
+    position.average_price = item.value("average_price", 0.0);
+    position.mark_price = item.value("mark_price", 0.0);
+    position.realized_pnl = item.value("realized_profit_loss", 0.0);
+    position.inverse = isInverse(position.instrument);
+    markToMarket(position);
+    return position;
+}
+
+}  // namespace
+
+PositionKeeper::Entry& PositionKeeper::entry(const std::string& instrument) {
+    {
+        std::shared_lock lock(mutex_);
+        auto it = entries_.find(instrument);
+        if (it != entries_.end()) {
+            return *it->second;
+        }
+    }
+    std::unique_lock lock(mutex_);
+    auto& slot = entries_[instrument];
+    if (!slot) {
+        slot = std::make_unique<Entry>();
+        slot->position.instrument = instrument;
+        slot->position.inverse = isInverse(instrument);
+    }
+    return *slot;
+}
+
+PositionKeeper::Entry* PositionKeeper::find(const std::string& instrument) const {
+    std::shared_lock lock(mutex_);
+    auto it = entries_.find(instrument);
+    return it == entries_.end() ? nullptr : it->second.get();
+}
+
+bool PositionKeeper::load(const std::string& response) {
+    try {
+        auto data = nlohmann::json::parse(response);
+        if (!data.contains("result") || !data["result"].is_array()) {
+            Logger::log("Positions response has no result array.");
+            return false;
+        }
+        for (const auto& item : data["result"]) {
+            Position position = fromExchange(item);
+            Entry& e = entry(position.instrument);
+            std::lock_guard lock(e.mutex);
+            e.position = position;
+            e.disputed = false;
+        }
+        return true;
+    } catch (const std::exception& e) {
+        Logger::log("Error loading positions: " + std::string(e.what()));
+        return false;
+    }
+}
+
+size_t PositionKeeper::reconcile(const std::string& response) {
+    size_t corrected = 0;
+    try {
+        auto data = nlohmann::json::parse(response);
+        if (!data.contains("result") || !data["result"].is_array()) {
+            Logger::log("Positions response has no result array.");
+            return 0;
+        }
+        for (const auto& item : data["result"]) {
+            Position exchange = fromExchange(item);
+            Entry& e = entry(exchange.instrument);
+            std::lock_guard lock(e.mutex);
+            if (std::fabs(e.position.size - exchange.size) <= kSizeEpsilon) {
+                e.disputed = false;
+                continue;
+            }
+            if (!e.disputed || std::fabs(e.disputed_size - exchange.size) > kSizeEpsilon) {
+                e.disputed = true;
+                e.disputed_size = exchange.size;
+                continue;
+            }
+            Logger::log("Position " + exchange.instrument + " is " + std::to_string(e.position.size) +
+                        " locally but " + std::to_string(exchange.size) + " on the exchange; adopting exchange state.");
+            if (e.position.mark_price > 0.0) {
+                exchange.mark_price = e.position.mark_price;
+                markToMarket(exchange);
+            }
+            e.position = exchange;
+            e.disputed = false;
+            ++corrected;
+        }
+    } catch (const std::exception& e) {
+        Logger::log("Error reconciling positions: " + std::string(e.what()));
+    }
+    return corrected;
+}
+
+void PositionKeeper::setPosition(const Position& position) {
+    Entry& e = entry(position.instrument);
+    std::lock_guard lock(e.mutex);
+    double mark_price = position.mark_price > 0.0 ? position.mark_price : e.position.mark_price;
+    e.position = position;
+    e.position.inverse = isInverse(position.instrument);
+    e.position.mark_price = mark_price;
+    markToMarket(e.position);
+    e.disputed = false;
+}
+
+// Fills on the side of the position average into its entry price (harmonic
+// for inverse contracts); fills against it realize PnL on the closed part,
+// and any remainder opens a new position at the fill price.
+void PositionKeeper::onFill(const std::string& instrument, Side side, double quantity, double price) {
+    if (quantity <= 0.0 || price <= 0.0) {
+        return;
+    }
+    Entry& e = entry(instrument);
+    std::lock_guard lock(e.mutex);
+    Position& position = e.position;
+    double signed_quantity = side == Side::Bid ? quantity : -quantity;
+
+    if (position.size == 0.0 || (position.size > 0.0) == (signed_quantity > 0.0)) {
+        double held = std::fabs(position.size);
+        if (held == 0.0 || position.average_price <= 0.0) {
+            position.average_price = price;
+        } else if (position.inverse) {
+            position.average_price = (held + quantity) / (held / position.average_price + quantity / price);
+        } else {
+            position.average_price = (held * position.average_price + quantity * price) / (held + quantity);
+        }
+        position.size += signed_quantity;
+    } else {
+        double closed = std::min(quantity, std::fabs(position.size));
+        double direction = position.size > 0.0 ? 1.0 : -1.0;
+        position.realized_pnl += pnl(position, direction * closed, position.average_price, price);
+        position.size += signed_quantity;
+        if (std::fabs(position.size) <= kSizeEpsilon) {
+            position.size = 0.0;
+            position.average_price = 0.0;
+        } else if (quantity > closed) {
+            position.average_price = price;
+        }
+    }
+    if (position.mark_price <= 0.0) {
+        position.mark_price = price;
+    }
+    markToMarket(position);
+}
+
+void PositionKeeper::onMark(const std::string& instrument, double mark_price) {
+    if (mark_price <= 0.0) {
+        return;
+    }
+    Entry* e = find(instrument);
+    if (!e) {
+        return;
+    }
+    std::lock_guard lock(e->mutex);
+    e->position.mark_price = mark_price;
+    markToMarket(e->position);
+}
+
+bool PositionKeeper::getPosition(const std::string& instrument, Position& position) const {
+    Entry* e = find(instrument);
+    if (!e) {
+        return false;
+    }
+    std::lock_guard lock(e->mutex);
+    position = e->position;
+    return true;
+}
+
+std::vector<Position> PositionKeeper::positions() const {
+    std::vector<Position> result;
+    std::shared_lock lock(mutex_);
+    result.reserve(entries_.size());
+    for (const auto& [instrument, e] : entries_) {
+        std::lock_guard entry_lock(e->mutex);
+        result.push_back(e->position);
+    }
+    return result;
+}
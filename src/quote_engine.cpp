@@ -0,0 +1,287 @@
+#include "quote_engine.h"
+#include "logger.h"
+#include <algorithm>
+
+namespace {
+
+size_t sideIndex(Side side) {
+    return side == Side::Bid ? 0 : 1;
+}
+
+// Whether the reply's per-quote errors include this instrument and side.
+bool quoteFailed(const Json::Value& reply, const std::string& instrument, size_t side) {
+    const Json::Value& result = reply["result"];
+    if (!result.isObject() || !result["errors"].isArray()) {
+        return false;
+    }
+    for (const auto& error : result["errors"]) {
+        if (!error.isObject() || error.get("instrument_name", "").asString() != instrument) {
+            continue;
+        }
+        std::string failed = error.get("side", "").asString();
+        if (failed.empty() || failed == (side == 0 ? "bid" : "ask") || failed == (side == 0 ? "buy" : "sell")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+QuoteEngine::QuoteEngine(OrderManager& orders) : orders_(orders) {}
+
+void QuoteEngine::setMassQuote(QuoteSender sender) {
+    mass_quote_ = std::move(sender);
+}
+
+QuoteEngine::Group& QuoteEngine::group(const std::string& name) {
+    std::lock_guard<std::mutex> lock(groups_mutex_);
+    auto& slot = groups_[name];
+    if (!slot) {
+        slot = std::make_unique<Group>();
+    }
+    return *slot;
+}
+
+bool QuoteEngine::submit(const std::string& name, const std::vector<Quote>& desired) {
+    std::unordered_map<std::string, Sides> wanted;
+    for (const auto& quote : desired) {
+        if (quote.amount > 0.0 && quote.price > 0.0) {
+            wanted.try_emplace(quote.instrument, Sides{nullptr, nullptr}).first->second[sideIndex(quote.side)] = &quote;
+        }
+    }
+    quotes_ += desired.size();
+
+    Group& g = group(name);
+    std::lock_guard<std::mutex> lock(g.mutex);
+    return mass_quote_ ? submitMassQuote(name, g, wanted) : submitOrders(g, wanted);
+}
+
+bool QuoteEngine::cancel(const std::string& name) {
+    return submit(name, {});
+}
+
+void QuoteEngine::onOrderUpdate(const Json::Value& order) {
+    if (!order.isObject()) {
+        return;
+    }
+    // quote_id is "<group>-<n>", as sent by submitMassQuote
+    std::string quote_id = order.get("quote_id", "").asString();
+    size_t dash = quote_id.rfind('-');
+    if (dash == std::string::npos) {
+        return;
+    }
+    Group* g = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(groups_mutex_);
+        auto it = groups_.find(quote_id.substr(0, dash));
+        if (it == groups_.end()) {
+            return;
+        }
+        g = it->second.get();
+    }
+    std::lock_guard<std::mutex> lock(g->mutex);
+    auto live = g->live.find(order.get("instrument_name", "").asString());
+    if (live == g->live.end()) {
+        return;
+    }
+    Live& side = live->second[order.get("direction", "").asString() == "buy" ? 0 : 1];
+    bool open = order.get("order_state", "").asString() == "open";
+    double remaining = order.get("amount", 0.0).asDouble() - order.get("filled_amount", 0.0).asDouble();
+    side.price = open ? order.get("price", 0.0).asDouble() : 0.0;
+    side.amount = open ? std::max(remaining, 0.0) : 0.0;
+}
+
+void QuoteEngine::invalidate(const std::string& name) {
+    Group& g = group(name);
+    std::lock_guard<std::mutex> lock(g.mutex);
+    for (auto& [instrument, sides] : g.live) {
+        for (Live& live : sides) {
+            live.price = 0.0;
+            live.amount = 0.0;
+        }
+    }
+}
+
+// Live orders are read back from the order cache, so fills and exchange
+// cancels are seen: an order that is gone is placed again, and a partly
+// filled one is edited to rest the desired amount on top of its fills.
+bool QuoteEngine::submitOrders(Group& g, const std::unordered_map<std::string, Sides>& desired) {
+    std::vector<OrderRequest> places;
+    std::vector<std::pair<std::string, size_t>> place_slots;
+    std::vector<OrderAmend> amends;
+    std::vector<std::string> cancels;
+
+    for (auto& [instrument, sides] : g.live) {
+        for (size_t side = 0; side < 2; ++side) {
+            Live& live = sides[side];
+            OrderRecord record;
+            if (!live.order_id.empty() && (!orders_.getOrder(live.order_id, record) || isTerminal(record.state))) {
+                live.order_id.clear();
+            }
+            auto wanted = desired.find(instrument);
+            const Quote* quote = wanted == desired.end() ? nullptr : wanted->second[side];
+            if (live.order_id.empty()) {
+                continue;
+            }
+            if (!quote) {
+                cancels.push_back(live.order_id);
+            } else if (record.price != quote->price || record.quantity - record.filled != quote->amount) {
+                amends.push_back({live.order_id, record.filled + quote->amount, quote->price});
+            } else {
+                ++unchanged_;
+            }
+        }
+    }
+    for (const auto& [instrument, sides] : desired) {
+        auto live = g.live.find(instrument);
+        for (size_t side = 0; side < 2; ++side) {
+            if (sides[side] && (live == g.live.end() || live->second[side].order_id.empty())) {
+                places.push_back({instrument, sides[side]->amount, side == 0 ? "buy" : "sell", sides[side]->price});
+                place_slots.emplace_back(instrument, side);
+            }
+        }
+    }
+
+    bool ok = true;
+    if (!cancels.empty()) {
+        BatchResult result = orders_.cancelOrders(cancels);
+        cancelled_ += result.accepted;
+        ok &= result.accepted == cancels.size();
+    }
+    if (!amends.empty()) {
+        BatchResult result = orders_.modifyOrders(amends);
+        amended_ += result.accepted;
+        ok &= result.accepted == amends.size();
+    }
+    if (!places.empty()) {
+        BatchResult result = orders_.placeOrders(places);
+        for (size_t i = 0; i < places.size(); ++i) {
+            g.live[place_slots[i].first][place_slots[i].second].order_id = result.order_ids[i];
+        }
+        placed_ += result.accepted;
+        ok &= result.accepted == places.size();
+    }
+    messages_ += cancels.size() + amends.size() + places.size();
+    return ok;
+}
+
+// A mass quote replaces the listed sides and leaves the others alone, so
+// instruments losing a side are cancelled first and then re-sent with the
+// sides they keep. Live sides change only when the exchange replies; until
+// then a resubmit diffs against the previous state and may send again.
+bool QuoteEngine::submitMassQuote(const std::string& name, Group& g,
+                                  const std::unordered_map<std::string, Sides>& desired) {
+    std::vector<std::string> cancels;
+    for (auto& [instrument, sides] : g.live) {
+        auto wanted = desired.find(instrument);
+        for (size_t side = 0; side < 2; ++side) {
+            if (sides[side].amount > 0.0 && (wanted == desired.end() || !wanted->second[side])) {
+                cancels.push_back(instrument);
+                break;
+            }
+        }
+    }
+    bool ok = true;
+    for (const auto& instrument : cancels) {
+        Json::Value params;
+        params["cancel_type"] = "instrument";
+        params["instrument_name"] = instrument;
+        ++messages_;
+        ok &= mass_quote_("private/cancel_quotes", params, [this, &g, instrument](const Json::Value& reply) {
+            if (reply.isMember("error")) {
+                return;  // still live; the next submit cancels again
+            }
+            std::lock_guard<std::mutex> lock(g.mutex);
+            for (Live& live : g.live[instrument]) {
+                if (live.amount > 0.0) {
+                    ++cancelled_;
+                }
+                live = Live();
+            }
+        });
+    }
+
+    Json::Value quotes(Json::arrayValue);
+    for (const auto& [instrument, sides] : desired) {
+        std::array<Live, 2>& live = g.live[instrument];
+        Json::Value entry;
+        for (size_t side = 0; side < 2; ++side) {
+            if (!sides[side]) {
+                continue;
+            }
+            if (live[side].price == sides[side]->price && live[side].amount == sides[side]->amount) {
+                ++unchanged_;
+                continue;
+            }
+            Json::Value level;
+            level["price"] = sides[side]->price;
+            level["amount"] = sides[side]->amount;
+            entry[side == 0 ? "bid" : "ask"] = level;
+        }
+        if (!entry.isNull()) {
+            entry["instrument_name"] = instrument;
+            quotes.append(entry);
+        }
+    }
+    if (quotes.empty()) {
+        return ok;
+    }
+
+    Json::Value params;
+    params["quote_id"] = name + "-" + std::to_string(++g.next_quote_id);
+    params["mmp_group"] = name;
+    params["quotes"] = quotes;
+    ++messages_;
+    bool sent = mass_quote_("private/mass_quote", params, [this, name, &g, quotes](const Json::Value& reply) {
+        onMassQuoteReply(name, g, quotes, reply);
+    });
+    if (!sent) {
+        Logger::log("Mass quote for " + name + " could not be sent.");
+        return false;
+    }
+    return ok;
+}
+
+// A failed request (an MMP trigger, say) may have pulled any of the group's
+// quotes, so all of them are resent on the next submit.
+void QuoteEngine::onMassQuoteReply(const std::string& name, Group& g, const Json::Value& quotes,
+                                   const Json::Value& reply) {
+    std::lock_guard<std::mutex> lock(g.mutex);
+    if (reply.isMember("error")) {
+        Logger::log("Mass quote for " + name + " failed: " + reply["error"].get("message", "").asString());
+        for (auto& [instrument, sides] : g.live) {
+            sides = {};
+        }
+        return;
+    }
+    for (const auto& entry : quotes) {
+        std::string instrument = entry["instrument_name"].asString();
+        std::array<Live, 2>& live = g.live[instrument];
+        for (size_t side = 0; side < 2; ++side) {
+            const Json::Value& level = entry[side == 0 ? "bid" : "ask"];
+            if (level.isNull()) {
+                continue;
+            }
+            if (quoteFailed(reply, instrument, side)) {
+                live[side] = Live();
+                continue;
+            }
+            bool resting = live[side].amount > 0.0;
+            live[side].price = level["price"].asDouble();
+            live[side].amount = level["amount"].asDouble();
+            ++(resting ? amended_ : placed_);
+        }
+    }
+}
+
+QuoteStats QuoteEngine::stats() const {
+    QuoteStats stats;
+    stats.quotes = quotes_;
+    stats.unchanged = unchanged_;
+    stats.placed = placed_;
+    stats.amended = amended_;
+    stats.cancelled = cancelled_;
+    stats.messages = messages_;
+    return stats;
+}
@@ -0,0 +1,239 @@
+#include "risk_engine.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+void atomicAdd(std::atomic<double>& value, double delta) {
+    double current = value.load(std::memory_order_relaxed);
+    while (!value.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+    }
+}
+
+bool exceeds(double value, double limit) {
+    return limit > 0.0 && value > limit;
+}
+
+}  // namespace
+
+const char* toString(RiskResult result) {
+    switch (result) {
+    case RiskResult::Accepted: return "accepted";
+    case RiskResult::UnknownInstrument: return "unknown instrument";
+    case RiskResult::OrderSize: return "order size";
+    case RiskResult::OrderNotional: return "order notional";
+    case RiskResult::Position: return "position";
+    case RiskResult::PositionNotional: return "position notional";
+    case RiskResult::CurrencyNotional: return "currency notional";
+    case RiskResult::PriceBand: return "price band";
+    case RiskResult::NoReferencePrice: return "no reference price";
+    case RiskResult::OpenOrders: return "open orders";
+    case RiskResult::RateLimit: return "rate limit";
+    }
+    return "unknown";
+}
+
+bool RiskEngine::RateLimiter::tryAcquire(uint32_t per_second, int64_t now_ms) {
+    if (per_second == 0) {
+        return true;
+    }
+    uint64_t window = static_cast<uint64_t>(now_ms / 1000) & 0xffffffffULL;
+    uint64_t current = state_.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t count = (current >> 32) == window ? (current & 0xffffffffULL) : 0;
+        if (count >= per_second) {
+            return false;
+        }
+        if (state_.compare_exchange_weak(current, window << 32 | (count + 1), std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+RiskEngine::RiskEngine(uint32_t max_orders_per_second) : max_orders_per_second_(max_orders_per_second) {}
+
+uint32_t RiskEngine::addInstrument(const std::string& instrument, const std::string& currency, const RiskLimits& limits) {
+    auto existing = instrument_ids_.find(instrument);
+    if (existing != instrument_ids_.end()) {
+        instruments_[existing->second]->limits = limits;
+        return existing->second;
+    }
+    auto [currency_it, inserted] = currency_ids_.try_emplace(currency, static_cast<uint32_t>(currencies_.size()));
+    if (inserted) {
+        currencies_.push_back(std::make_unique<Currency>());
+    }
+    uint32_t id = static_cast<uint32_t>(instruments_.size());
+    instruments_.push_back(std::make_unique<Instrument>());
+    instruments_[id]->limits = limits;
+    instruments_[id]->currency = currency_it->second;
+    currencies_[currency_it->second]->instruments.push_back(id);
+    instrument_ids_.emplace(instrument, id);
+    return id;
+}
+
+void RiskEngine::setCurrencyLimit(const std::string& currency, double max_gross_notional) {
+    auto [it, inserted] = currency_ids_.try_emplace(currency, static_cast<uint32_t>(currencies_.size()));
+    if (inserted) {
+        currencies_.push_back(std::make_unique<Currency>());
+    }
+    currencies_[it->second]->max_gross_notional = max_gross_notional;
+}
+
+uint32_t RiskEngine::find(const std::string& instrument) const {
+    auto it = instrument_ids_.find(instrument);
+    return it == instrument_ids_.end() ? UINT32_MAX : it->second;
+}
+
+RiskResult RiskEngine::check(uint32_t id, Side side, double quantity, double price, int64_t now_ms) {
+    return evaluate(id, side, quantity, quantity, price, now_ms, true);
+}
+
+RiskResult RiskEngine::checkAmend(uint32_t id, Side side, double old_quantity, double new_quantity, double price,
+                                  int64_t now_ms) {
+    return evaluate(id, side, new_quantity, std::max(new_quantity - old_quantity, 0.0), price, now_ms, false);
+}
+
+void RiskEngine::release(uint32_t id, Side side, double quantity) {
+    if (id < instruments_.size()) {
+        adjustExposure(*instruments_[id], side, -quantity);
+    }
+}
+
+// Worst-case position if every open order on one side fills, valued at mid.
+double RiskEngine::worstNotional(const Instrument& instrument) const {
+    double position = instrument.position.load(std::memory_order_relaxed);
+    double worst = std::max(std::fabs(position + instrument.open_buy.load(std::memory_order_relaxed)),
+                            std::fabs(position - instrument.open_sell.load(std::memory_order_relaxed)));
+    double bid = instrument.bid.load(std::memory_order_relaxed);
+    double ask = instrument.ask.load(std::memory_order_relaxed);
+    return worst * (bid > 0.0 && ask > 0.0 ? (bid + ask) / 2.0 : std::max(bid, ask));
+}
+
+// Stateless checks first; then the open-order slot and the reserved
+// quantity are taken and the limits that depend on them verified, rolling
+// back on failure. The rate limit is taken last so rejected orders do not
+// use it up.
+RiskResult RiskEngine::evaluate(uint32_t id, Side side, double quantity, double reserve, double price, int64_t now_ms,
+                                bool new_order) {
+    if (id >= instruments_.size()) {
+        return RiskResult::UnknownInstrument;
+    }
+    Instrument& instrument = *instruments_[id];
+    const RiskLimits& limits = instrument.limits;
+    if (exceeds(quantity, limits.max_order_size)) {
+        return RiskResult::OrderSize;
+    }
+
+    double bid = instrument.bid.load(std::memory_order_relaxed);
+    double ask = instrument.ask.load(std::memory_order_relaxed);
+    double far_touch = side == Side::Bid ? ask : bid;
+    double reference = price > 0.0 ? price : far_touch;
+    bool needs_reference = limits.max_order_notional > 0.0 || limits.max_position_notional > 0.0;
+    if ((needs_reference && reference <= 0.0) || (limits.price_band > 0.0 && far_touch <= 0.0)) {
+        return RiskResult::NoReferencePrice;
+    }
+    if (exceeds(quantity * reference, limits.max_order_notional)) {
+        return RiskResult::OrderNotional;
+    }
+    if (limits.price_band > 0.0 && price > 0.0 &&
+        (side == Side::Bid ? price > ask * (1.0 + limits.price_band) : price < bid * (1.0 - limits.price_band))) {
+        return RiskResult::PriceBand;
+    }
+
+    if (new_order) {
+        uint32_t open = instrument.open_orders.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (limits.max_open_orders != 0 && open > limits.max_open_orders) {
+            instrument.open_orders.fetch_sub(1, std::memory_order_relaxed);
+            return RiskResult::OpenOrders;
+        }
+    }
+    adjustExposure(instrument, side, reserve);
+    auto rollback = [&](RiskResult result) {
+        adjustExposure(instrument, side, -reserve);
+        if (new_order) {
+            instrument.open_orders.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return result;
+    };
+
+    if (reserve > 0.0) {
+        double position = instrument.position.load(std::memory_order_relaxed);
+        double worst = side == Side::Bid ? position + instrument.open_buy.load(std::memory_order_relaxed)
+                                         : position - instrument.open_sell.load(std::memory_order_relaxed);
+        if (exceeds(std::fabs(worst), limits.max_position)) {
+            return rollback(RiskResult::Position);
+        }
+        if (exceeds(std::fabs(worst) * reference, limits.max_position_notional)) {
+            return rollback(RiskResult::PositionNotional);
+        }
+        const Currency& currency = *currencies_[instrument.currency];
+        if (currency.max_gross_notional > 0.0) {
+            double gross = 0.0;
+            for (uint32_t member : currency.instruments) {
+                gross += worstNotional(*instruments_[member]);
+            }
+            if (gross > currency.max_gross_notional) {
+                return rollback(RiskResult::CurrencyNotional);
+            }
+        }
+    }
+    if (!rate_.tryAcquire(max_orders_per_second_, now_ms) ||
+        !instrument.rate.tryAcquire(limits.max_orders_per_second, now_ms)) {
+        return rollback(RiskResult::RateLimit);
+    }
+    return RiskResult::Accepted;
+}
+
+void RiskEngine::adjustExposure(Instrument& instrument, Side side, double delta) {
+    atomicAdd(side == Side::Bid ? instrument.open_buy : instrument.open_sell, delta);
+}
+
+void RiskEngine::setBbo(uint32_t id, double bid, double ask) {
+    if (id < instruments_.size()) {
+        instruments_[id]->bid.store(bid, std::memory_order_relaxed);
+        instruments_[id]->ask.store(ask, std::memory_order_relaxed);
+    }
+}
+
+void RiskEngine::setPosition(uint32_t id, double position) {
+    if (id < instruments_.size()) {
+        instruments_[id]->position.store(position, std::memory_order_relaxed);
+    }
+}
+
+void RiskEngine::onFill(uint32_t id, Side side, double quantity) {
+    if (id >= instruments_.size()) {
+        return;
+    }
+    Instrument& instrument = *instruments_[id];
+    atomicAdd(instrument.position, side == Side::Bid ? quantity : -quantity);
+    adjustExposure(instrument, side, -quantity);
+}
+
+void RiskEngine::onOrderDone(uint32_t id, Side side, double remaining) {
+    if (id >= instruments_.size()) {
+        return;
+    }
+    Instrument& instrument = *instruments_[id];
+    adjustExposure(instrument, side, -remaining);
+    uint32_t open = instrument.open_orders.load(std::memory_order_relaxed);
+    while (open > 0 && !instrument.open_orders.compare_exchange_weak(open, open - 1, std::memory_order_relaxed)) {
+    }
+}
+
+void RiskEngine::onOrderRestored(uint32_t id, Side side, double remaining) {
+    if (id >= instruments_.size()) {
+        return;
+    }
+    Instrument& instrument = *instruments_[id];
+    adjustExposure(instrument, side, remaining);
+    instrument.open_orders.fetch_add(1, std::memory_order_relaxed);
+}
+
+double RiskEngine::position(uint32_t id) const {
+    return id < instruments_.size() ? instruments_[id]->position.load(std::memory_order_relaxed) : 0.0;
+}
+
+uint32_t RiskEngine::openOrders(uint32_t id) const {
+    return id < instruments_.size() ? instruments_[id]->open_orders.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,75 @@
+#include "subscription_demand.h"
+#include "logger.h"
+
+SubscriptionDemand::SubscriptionDemand(Clock::duration grace) : grace_(grace) {}
+
+void SubscriptionDemand::setListener(Listener listener) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    listener_ = std::move(listener);
+}
+
+void SubscriptionDemand::setUniverse(const std::vector<std::string>& symbols) {
+    std::unordered_set<std::string> universe(symbols.begin(), symbols.end());
+    std::lock_guard<std::mutex> lock(mutex_);
+    universe_ = std::move(universe);
+}
+
+bool SubscriptionDemand::known(const std::string& symbol) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return universe_.count(symbol) != 0;
+}
+
+bool SubscriptionDemand::acquire(const std::string& symbol) {
+    Listener listener;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!universe_.count(symbol)) {
+            return false;
+        }
+        auto [it, inserted] = entries_.try_emplace(symbol);
+        ++it->second.refs;
+        if (!inserted) {
+            return true;
+        }
+        listener = listener_;
+    }
+    Logger::log("Upstream subscription started: " + symbol);
+    if (listener) {
+        listener(symbol, true);
+    }
+    return true;
+}
+
+void SubscriptionDemand::release(const std::string& symbol) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(symbol);
+    if (it != entries_.end() && it->second.refs != 0 && --it->second.refs == 0) {
+        it->second.released_at = Clock::now();
+    }
+}
+
+std::vector<std::string> SubscriptionDemand::active(Clock::time_point now) {
+    std::vector<std::string> symbols;
+    std::vector<std::string> stopped;
+    Listener listener;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (it->second.refs == 0 && now - it->second.released_at >= grace_) {
+                stopped.push_back(it->first);
+                it = entries_.erase(it);
+            } else {
+                symbols.push_back(it->first);
+                ++it;
+            }
+        }
+        listener = listener_;
+    }
+    for (const auto& symbol : stopped) {
+        Logger::log("Upstream subscription stopped: " + symbol);
+        if (listener) {
+            listener(symbol, false);
+        }
+    }
+    return symbols;
+}
@@ -0,0 +1,458 @@
+#include "tick_store.h"
+#include "logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define TICK_STORE_SSE2 1
+#endif
+
+namespace {
+
+constexpr double kValueScale = 1e8;  // prices and sizes are stored as 1e-8 fixed point
+constexpr char kFileMagic[4] = {'D', 'T', 'S', '2'};
+// Version 1 files also carry a price min/max per block, which load skips.
+constexpr char kFileMagicV1[4] = {'D', 'T', 'S', '1'};
+constexpr uint64_t kMaxBlockRows = uint64_t(1) << 24;  // larger values in a file are taken as corruption
+// rows, ts_min, ts_max, data size
+constexpr uint64_t kBlockHeaderBytes = sizeof(uint32_t) + 2 * sizeof(int64_t) + sizeof(uint64_t);
+
+void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+// False if the varint runs past end or is longer than 64 bits allow.
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+int64_t toFixed(double v) { return std::llround(v * kValueScale); }
+double fromFixed(int64_t v) { return static_cast<double>(v) / kValueScale; }
+
+template <typename T, typename Fn>
+void putDeltaColumn(std::vector<uint8_t>& out, const std::vector<T>& col, Fn&& toInt) {
+    int64_t prev = 0;
+    for (const auto& v : col) {
+        int64_t cur = toInt(v);
+        putVarint(out, zigzag(cur - prev));
+        prev = cur;
+    }
+}
+
+// Weight is 1.0 for rows inside [from, to] that match side/level (-1 matches any).
+void buildMask(const TickColumns& c, int64_t from, int64_t to, int side, int level, double* w) {
+    const size_t n = c.rows();
+    const int64_t* ts = c.timestamp.data();
+    const uint8_t* sd = c.side.data();
+    const uint8_t* lv = c.level.data();
+    for (size_t i = 0; i < n; ++i) {
+        bool keep = (ts[i] >= from) & (ts[i] <= to) &
+                    ((side < 0) | (sd[i] == side)) & ((level < 0) | (lv[i] == level));
+        w[i] = keep ? 1.0 : 0.0;
+    }
+}
+
+// num += sum(px * sz * w), den += sum(sz * w)
+void weightedSums(const double* px, const double* sz, const double* w, size_t n, double& num, double& den) {
+    size_t i = 0;
+#ifdef TICK_STORE_SSE2
+    __m128d num0 = _mm_setzero_pd(), num1 = _mm_setzero_pd();
+    __m128d den0 = _mm_setzero_pd(), den1 = _mm_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        __m128d s0 = _mm_mul_pd(_mm_loadu_pd(sz + i), _mm_loadu_pd(w + i));
+        __m128d s1 = _mm_mul_pd(_mm_loadu_pd(sz + i + 2), _mm_loadu_pd(w + i + 2));
+        num0 = _mm_add_pd(num0, _mm_mul_pd(_mm_loadu_pd(px + i), s0));
+        num1 = _mm_add_pd(num1, _mm_mul_pd(_mm_loadu_pd(px + i + 2), s1));
+        den0 = _mm_add_pd(den0, s0);
+        den1 = _mm_add_pd(den1, s1);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(num0, num1));
+    num += lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, _mm_add_pd(den0, den1));
+    den += lanes[0] + lanes[1];
+#endif
+    for (; i < n; ++i) {
+        num += px[i] * sz[i] * w[i];
+        den += sz[i] * w[i];
+    }
+}
+
+void compact(const TickColumns& c, const double* w, TickColumns& out) {
+    for (size_t i = 0; i < c.rows(); ++i) {
+        if (w[i] != 0.0) {
+            out.push(c.timestamp[i], static_cast<Side>(c.side[i]), c.level[i], c.price[i], c.size[i]);
+        }
+    }
+}
+
+template <typename T>
+void writePod(std::ofstream& out, const T& v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+bool readPod(std::ifstream& in, T& v) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+}  // namespace
+
+void TickColumns::clear() {
+    timestamp.clear();
+    price.clear();
+    size.clear();
+    side.clear();
+    level.clear();
+}
+
+void TickColumns::reserve(size_t n) {
+    timestamp.reserve(n);
+    price.reserve(n);
+    size.reserve(n);
+    side.reserve(n);
+    level.reserve(n);
+}
+
+void TickColumns::push(int64_t ts, Side s, uint8_t lvl, double px, double sz) {
+    timestamp.push_back(ts);
+    price.push_back(px);
+    size.push_back(sz);
+    side.push_back(static_cast<uint8_t>(s));
+    level.push_back(lvl);
+}
+
+TickStore::TickStore(size_t block_rows) : block_rows_(block_rows ? block_rows : 4096) {
+    open_.reserve(block_rows_);
+}
+
+void TickStore::append(int64_t timestamp, Side side, uint8_t level, double price, double size) {
+    std::unique_lock lock(mutex_);
+    open_.push(timestamp, side, level, price, size);
+    if (open_.rows() >= block_rows_) {
+        sealLocked();
+    }
+}
+
+bool TickStore::appendOrderBook(const nlohmann::json& result) {
+    try {
+        if (!result.contains("timestamp") || !result.contains("bids") || !result.contains("asks")) {
+            return false;
+        }
+        int64_t ts = result["timestamp"].get<int64_t>();
+        auto appendSide = [&](const nlohmann::json& levels, Side side) {
+            size_t depth = std::min<size_t>(levels.size(), std::numeric_limits<uint8_t>::max());
+            for (size_t i = 0; i < depth; ++i) {
+                append(ts, side, static_cast<uint8_t>(i), levels[i][0].get<double>(), levels[i][1].get<double>());
+            }
+        };
+        appendSide(result["bids"], Side::Bid);
+        appendSide(result["asks"], Side::Ask);
+        return true;
+    } catch (const std::exception& e) {
+        Logger::log("Error capturing orderbook into tick store: " + std::string(e.what()));
+        return false;
+    }
+}
+
+void TickStore::seal() {
+    std::unique_lock lock(mutex_);
+    sealLocked();
+}
+
+void TickStore::sealLocked() {
+    const size_t n = open_.rows();
+    if (n == 0) {
+        return;
+    }
+
+    Block block;
+    block.rows = static_cast<uint32_t>(n);
+    auto ts = std::minmax_element(open_.timestamp.begin(), open_.timestamp.end());
+    block.ts_min = *ts.first;
+    block.ts_max = *ts.second;
+
+    std::vector<uint8_t>& out = block.data;
+    out.reserve(n * 6);
+    putDeltaColumn(out, open_.timestamp, [](int64_t v) { return v; });
+    putDeltaColumn(out, open_.price, toFixed);
+    putDeltaColumn(out, open_.size, toFixed);
+    size_t side_offset = out.size();
+    out.resize(side_offset + (n + 7) / 8, 0);
+    for (size_t i = 0; i < n; ++i) {
+        out[side_offset + i / 8] |= static_cast<uint8_t>((open_.side[i] & 1) << (i % 8));
+    }
+    out.insert(out.end(), open_.level.begin(), open_.level.end());
+    out.shrink_to_fit();
+
+    blocks_.push_back(std::move(block));
+    open_.clear();
+}
+
+bool TickStore::decode(const Block& block, TickColumns& out) {
+    const size_t n = block.rows;
+    const uint8_t* p = block.data.data();
+    const uint8_t* end = p + block.data.size();
+    // At least one byte per varint, a side bit and a level byte per row
+    if (block.data.size() < 3 * n + (n + 7) / 8 + n) {
+        return false;
+    }
+    out.timestamp.resize(n);
+    out.price.resize(n);
+    out.size.resize(n);
+    out.side.resize(n);
+    out.level.resize(n);
+
+    uint64_t v = 0;
+    // Deltas are summed as unsigned so corrupt input wraps instead of overflowing
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!getVarint(p, end, v)) {
+            return false;
+        }
+        prev += static_cast<uint64_t>(unzigzag(v));
+        out.timestamp[i] = static_cast<int64_t>(prev);
+    }
+    prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!getVarint(p, end, v)) {
+            return false;
+        }
+        prev += static_cast<uint64_t>(unzigzag(v));
+        out.price[i] = fromFixed(static_cast<int64_t>(prev));
+    }
+    prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!getVarint(p, end, v)) {
+            return false;
+        }
+        prev += static_cast<uint64_t>(unzigzag(v));
+        out.size[i] = fromFixed(static_cast<int64_t>(prev));
+    }
+    if (static_cast<size_t>(end - p) != (n + 7) / 8 + n) {
+        return false;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        out.side[i] = (p[i / 8] >> (i % 8)) & 1;
+    }
+    p += (n + 7) / 8;
+    std::memcpy(out.level.data(), p, n);
+    return true;
+}
+
+// Calls fn(columns) for every block whose zone map overlaps [from, to],
+// followed by the open block. Caller holds the shared lock.
+template <typename Fn>
+void TickStore::forEachRun(int64_t from, int64_t to, Fn&& fn) const {
+    TickColumns scratch;
+    scratch.reserve(block_rows_);
+    for (const auto& block : blocks_) {
+        if (block.ts_max < from || block.ts_min > to) {
+            continue;
+        }
+        if (decode(block, scratch)) {  // blocks are checked on load, so this only guards
+            fn(scratch);
+        }
+    }
+    if (open_.rows() > 0) {
+        fn(open_);
+    }
+}
+
+size_t TickStore::rows() const {
+    std::shared_lock lock(mutex_);
+    size_t total = open_.rows();
+    for (const auto& block : blocks_) {
+        total += block.rows;
+    }
+    return total;
+}
+
+size_t TickStore::blocks() const {
+    std::shared_lock lock(mutex_);
+    return blocks_.size();
+}
+
+size_t TickStore::compressedBytes() const {
+    std::shared_lock lock(mutex_);
+    size_t total = 0;
+    for (const auto& block : blocks_) {
+        total += block.data.size();
+    }
+    return total;
+}
+
+TickColumns TickStore::scan(int64_t from, int64_t to) const {
+    std::shared_lock lock(mutex_);
+    TickColumns result;
+    std::vector<double> mask;
+    forEachRun(from, to, [&](const TickColumns& c) {
+        mask.resize(c.rows());
+        buildMask(c, from, to, -1, -1, mask.data());
+        compact(c, mask.data(), result);
+    });
+    return result;
+}
+
+double TickStore::vwap(int64_t from, int64_t to, Side side) const {
+    std::shared_lock lock(mutex_);
+    double num = 0.0;
+    double den = 0.0;
+    std::vector<double> mask;
+    forEachRun(from, to, [&](const TickColumns& c) {
+        mask.resize(c.rows());
+        buildMask(c, from, to, static_cast<int>(side), -1, mask.data());
+        weightedSums(c.price.data(), c.size.data(), mask.data(), c.rows(), num, den);
+    });
+    return den > 0.0 ? num / den : 0.0;
+}
+
+SpreadStats TickStore::spreadStats(int64_t from, int64_t to) const {
+    std::shared_lock lock(mutex_);
+    SpreadStats stats;
+    double m2 = 0.0;
+    int64_t bid_ts = std::numeric_limits<int64_t>::min();
+    double bid = 0.0;
+    forEachRun(from, to, [&](const TickColumns& c) {
+        for (size_t i = 0; i < c.rows(); ++i) {
+            if (c.level[i] != 0 || c.timestamp[i] < from || c.timestamp[i] > to) {
+                continue;
+            }
+            if (c.side[i] == static_cast<uint8_t>(Side::Bid)) {
+                bid_ts = c.timestamp[i];
+                bid = c.price[i];
+                continue;
+            }
+            if (bid_ts != c.timestamp[i]) {
+                continue;
+            }
+            // Welford running mean/variance
+            double spread = c.price[i] - bid;
+            ++stats.count;
+            double delta = spread - stats.mean;
+            stats.mean += delta / static_cast<double>(stats.count);
+            m2 += delta * (spread - stats.mean);
+            stats.min = stats.count == 1 ? spread : std::min(stats.min, spread);
+            stats.max = stats.count == 1 ? spread : std::max(stats.max, spread);
+        }
+    });
+    if (stats.count > 1) {
+        stats.stddev = std::sqrt(m2 / static_cast<double>(stats.count - 1));
+    }
+    return stats;
+}
+
+TickColumns TickStore::depthAtLevel(int64_t from, int64_t to, Side side, uint8_t level) const {
+    std::shared_lock lock(mutex_);
+    TickColumns result;
+    std::vector<double> mask;
+    forEachRun(from, to, [&](const TickColumns& c) {
+        mask.resize(c.rows());
+        buildMask(c, from, to, static_cast<int>(side), level, mask.data());
+        compact(c, mask.data(), result);
+    });
+    return result;
+}
+
+bool TickStore::save(const std::string& filepath) {
+    std::unique_lock lock(mutex_);
+    sealLocked();
+
+    std::ofstream out(filepath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        Logger::log("Failed to open tick store file for writing: " + filepath);
+        return false;
+    }
+    out.write(kFileMagic, sizeof(kFileMagic));
+    writePod(out, static_cast<uint64_t>(block_rows_));
+    writePod(out, static_cast<uint64_t>(blocks_.size()));
+    for (const auto& block : blocks_) {
+        writePod(out, block.rows);
+        writePod(out, block.ts_min);
+        writePod(out, block.ts_max);
+        writePod(out, static_cast<uint64_t>(block.data.size()));
+        out.write(reinterpret_cast<const char*>(block.data.data()), static_cast<std::streamsize>(block.data.size()));
+    }
+    return static_cast<bool>(out);
+}
+
+bool TickStore::load(const std::string& filepath) {
+    std::ifstream in(filepath, std::ios::binary);
+    if (!in.is_open()) {
+        Logger::log("Failed to open tick store file for reading: " + filepath);
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    std::streamoff file_size = in.tellg();
+    in.seekg(0, std::ios::beg);
+    auto remaining = [&]() { return static_cast<uint64_t>(file_size - in.tellg()); };
+
+    char magic[sizeof(kFileMagic)];
+    uint64_t block_rows = 0;
+    uint64_t count = 0;
+    bool v1 = false;
+    if (file_size >= 0 && in.read(magic, sizeof(magic))) {
+        v1 = std::memcmp(magic, kFileMagicV1, sizeof(magic)) == 0;
+    }
+    uint64_t header_bytes = kBlockHeaderBytes + (v1 ? 2 * sizeof(double) : 0);
+    if (file_size < 0 || !in || (!v1 && std::memcmp(magic, kFileMagic, sizeof(magic)) != 0) ||
+        !readPod(in, block_rows) || !readPod(in, count) || block_rows > kMaxBlockRows ||
+        count > remaining() / header_bytes) {
+        Logger::log("Invalid tick store file: " + filepath);
+        return false;
+    }
+
+    // Every size is checked against what is left of the file before it is
+    // allocated, and every block is decoded once so queries never see a bad one.
+    std::vector<Block> blocks(count);
+    TickColumns scratch;
+    for (auto& block : blocks) {
+        uint64_t bytes = 0;
+        double price_range[2];
+        if (!readPod(in, block.rows) || !readPod(in, block.ts_min) || !readPod(in, block.ts_max) ||
+            (v1 && !readPod(in, price_range)) || !readPod(in, bytes) || bytes > remaining()) {
+            Logger::log("Truncated tick store file: " + filepath);
+            return false;
+        }
+        block.data.resize(bytes);
+        if (!in.read(reinterpret_cast<char*>(block.data.data()), static_cast<std::streamsize>(bytes))) {
+            Logger::log("Truncated tick store file: " + filepath);
+            return false;
+        }
+        if (block.rows == 0 || block.rows > kMaxBlockRows || !decode(block, scratch) ||
+            *std::min_element(scratch.timestamp.begin(), scratch.timestamp.end()) != block.ts_min ||
+            *std::max_element(scratch.timestamp.begin(), scratch.timestamp.end()) != block.ts_max) {
+            Logger::log("Corrupt block in tick store file: " + filepath);
+            return false;
+        }
+    }
+
+    std::unique_lock lock(mutex_);
+    if (!blocks_.empty() || open_.rows() > 0) {
+        Logger::log("Tick store already holds rows, not loading: " + filepath);
+        return false;
+    }
+    block_rows_ = block_rows ? block_rows : block_rows_;
+    blocks_ = std::move(blocks);
+    return true;
+}
@@ -0,0 +1,101 @@
+#include "timer_wheel.h"
+#include <algorithm>
+
+TimerWheel::TimerWheel(Clock::duration tick, size_t slots, Clock::time_point start, size_t levels)
+    : tick_(std::max(tick, Clock::duration(1))), start_(start), slots_(std::max<size_t>(slots, 2)) {
+    uint64_t span = 1;
+    for (size_t level = 0; level < std::max<size_t>(levels, 1); ++level) {
+        spans_.push_back(span);
+        levels_.emplace_back(slots_);
+        if (span > UINT64_MAX / slots_ / slots_) {
+            break;  // the next level could not be indexed
+        }
+        span *= slots_;
+    }
+}
+
+void TimerWheel::schedule(Clock::time_point deadline, uint64_t id) {
+    uint64_t expiry = current_;
+    if (deadline > start_) {
+        auto ticks = static_cast<uint64_t>((deadline - start_ + tick_ - Clock::duration(1)) / tick_);
+        expiry = std::max(expiry, ticks);
+    }
+    insert({id, expiry});
+    ++size_;
+}
+
+// The lowest level whose range from the current tick reaches the expiry.
+void TimerWheel::insert(const Timer& timer) {
+    uint64_t delta = timer.expiry - current_;
+    size_t level = 0;
+    while (level + 1 < levels_.size() && delta >= spans_[level + 1]) {
+        ++level;
+    }
+    levels_[level][(timer.expiry / spans_[level]) % slots_].push_back(timer);
+}
+
+// Re-files the bucket covering [tick, tick + span) into the levels below.
+void TimerWheel::cascade(size_t level, uint64_t tick) {
+    auto& bucket = levels_[level][(tick / spans_[level]) % slots_];
+    refile_.swap(bucket);
+    for (const Timer& timer : refile_) {
+        insert(timer);
+    }
+    refile_.clear();
+}
+
+// After a long stall, sweeping every bucket once beats stepping through
+// the ticks.
+void TimerWheel::collectAll(uint64_t target) {
+    current_ = target + 1;
+    for (auto& level : levels_) {
+        for (auto& bucket : level) {
+            for (const Timer& timer : bucket) {
+                (timer.expiry <= target ? due_ : refile_).push_back(timer);
+            }
+            bucket.clear();
+        }
+    }
+    for (const Timer& timer : refile_) {
+        insert(timer);
+    }
+    refile_.clear();
+    std::stable_sort(due_.begin(), due_.end(), [](const Timer& a, const Timer& b) { return a.expiry < b.expiry; });
+}
+
+void TimerWheel::advance(Clock::time_point now, const std::function<void(uint64_t id)>& fire) {
+    if (now < start_) {
+        return;
+    }
+    auto target = static_cast<uint64_t>((now - start_) / tick_);
+    if (target < current_) {
+        return;
+    }
+    due_.clear();
+    if (size_ == 0) {
+        current_ = target + 1;
+        return;
+    }
+    if (target - current_ > levels_.size() * slots_ + size_) {
+        collectAll(target);
+    } else {
+        for (; current_ <= target; ++current_) {
+            for (size_t level = levels_.size() - 1; level > 0; --level) {
+                if (current_ % spans_[level] == 0) {
+                    cascade(level, current_);
+                }
+            }
+            // Only a single-level wheel holds later revolutions in level 0.
+            auto& bucket = levels_[0][current_ % slots_];
+            auto later = std::stable_partition(bucket.begin(), bucket.end(),
+                                               [this](const Timer& timer) { return timer.expiry <= current_; });
+            due_.insert(due_.end(), bucket.begin(), later);
+            bucket.erase(bucket.begin(), later);
+        }
+    }
+    size_ -= due_.size();
+    // fire may schedule, which never touches due_
+    for (const Timer& timer : due_) {
+        fire(timer.id);
+    }
+}
@@ -0,0 +1,187 @@
+#include "trade_tape.h"
+#include <algorithm>
+#include <mutex>
+
+namespace {
+
+constexpr int kReadAttempts = 4;
+
+}  // namespace
+
+TradeRing::TradeRing(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    slots_ = std::make_unique<Slot[]>(size);
+    mask_ = size - 1;
+}
+
+// Seqlock-style publication: the release fence orders the new slot contents
+// after the previous end_ store, so a reader that sees any of them also sees
+// an end_ that tells it the slot was being reused.
+void TradeRing::push(const Trade& trade) {
+    uint64_t index = end_.load(std::memory_order_relaxed);
+    cum_volume_ += trade.amount;
+    cum_notional_ += trade.amount * trade.price;
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot& slot = slots_[index & mask_];
+    slot.trade_seq.store(trade.trade_seq, std::memory_order_relaxed);
+    slot.trade_id.store(trade.trade_id, std::memory_order_relaxed);
+    slot.timestamp.store(trade.timestamp, std::memory_order_relaxed);
+    slot.price.store(trade.price, std::memory_order_relaxed);
+    slot.amount.store(trade.amount, std::memory_order_relaxed);
+    slot.cum_volume.store(cum_volume_, std::memory_order_relaxed);
+    slot.cum_notional.store(cum_notional_, std::memory_order_relaxed);
+    slot.side.store(static_cast<uint8_t>(trade.side), std::memory_order_relaxed);
+    end_.store(index + 1, std::memory_order_release);
+}
+
+uint64_t TradeRing::end() const {
+    return end_.load(std::memory_order_acquire);
+}
+
+uint64_t TradeRing::begin() const {
+    uint64_t end = this->end();
+    return end > mask_ ? end - mask_ : 0;  // the oldest slot may be mid-overwrite
+}
+
+bool TradeRing::readSlot(uint64_t index, Trade& trade, double& cum_volume, double& cum_notional) const {
+    if (index >= end()) {
+        return false;
+    }
+    const Slot& slot = slots_[index & mask_];
+    trade.trade_seq = slot.trade_seq.load(std::memory_order_relaxed);
+    trade.trade_id = slot.trade_id.load(std::memory_order_relaxed);
+    trade.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+    trade.price = slot.price.load(std::memory_order_relaxed);
+    trade.amount = slot.amount.load(std::memory_order_relaxed);
+    cum_volume = slot.cum_volume.load(std::memory_order_relaxed);
+    cum_notional = slot.cum_notional.load(std::memory_order_relaxed);
+    trade.side = static_cast<Side>(slot.side.load(std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // The writer starts reusing this slot once end_ reaches index + capacity.
+    return end_.load(std::memory_order_relaxed) - index <= mask_;
+}
+
+bool TradeRing::read(uint64_t index, Trade& trade) const {
+    double cum_volume;
+    double cum_notional;
+    return readSlot(index, trade, cum_volume, cum_notional);
+}
+
+size_t TradeRing::forEach(uint64_t first, uint64_t end, const std::function<void(const Trade&)>& fn) const {
+    size_t visited = 0;
+    Trade trade;
+    for (uint64_t index = std::max(first, begin()); index < end; ++index) {
+        if (read(index, trade)) {
+            fn(trade);
+            ++visited;
+        }
+    }
+    return visited;
+}
+
+uint64_t TradeRing::lowerBound(int64_t timestamp) const {
+    uint64_t lo = begin();
+    uint64_t hi = end();
+    Trade trade;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        // An overwritten record was older than everything still held.
+        if (!read(mid, trade) || trade.timestamp < timestamp) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool TradeRing::totalsSince(uint64_t first, double& volume, double& notional) const {
+    uint64_t last = end();
+    volume = 0.0;
+    notional = 0.0;
+    if (first >= last) {
+        return true;
+    }
+    Trade oldest;
+    Trade newest;
+    double first_volume;
+    double first_notional;
+    double last_volume;
+    double last_notional;
+    if (!readSlot(first, oldest, first_volume, first_notional) ||
+        !readSlot(last - 1, newest, last_volume, last_notional)) {
+        return false;
+    }
+    volume = last_volume - first_volume + oldest.amount;
+    notional = last_notional - first_notional + oldest.amount * oldest.price;
+    return true;
+}
+
+double TradeRing::volumeSince(int64_t timestamp) const {
+    double volume = 0.0;
+    double notional = 0.0;
+    for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+        if (totalsSince(lowerBound(timestamp), volume, notional)) {
+            break;
+        }
+    }
+    return volume;
+}
+
+double TradeRing::vwapSince(int64_t timestamp) const {
+    double volume = 0.0;
+    double notional = 0.0;
+    for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+        if (totalsSince(lowerBound(timestamp), volume, notional)) {
+            break;
+        }
+    }
+    return volume > 0.0 ? notional / volume : 0.0;
+}
+
+TradeTape::TradeTape(size_t capacity) : capacity_(capacity) {}
+
+void TradeTape::append(const std::string& instrument, const std::vector<Trade>& trades) {
+    if (trades.empty()) {
+        return;
+    }
+    TradeRing* ring = nullptr;
+    {
+        std::shared_lock lock(mutex_);
+        auto it = rings_.find(instrument);
+        if (it != rings_.end()) {
+            ring = it->second.get();
+        }
+    }
+    if (!ring) {
+        std::unique_lock lock(mutex_);
+        auto& slot = rings_[instrument];
+        if (!slot) {
+            slot = std::make_unique<TradeRing>(capacity_);
+        }
+        ring = slot.get();
+    }
+    uint64_t first = ring->end();
+    for (const auto& trade : trades) {
+        ring->push(trade);
+    }
+    uint64_t end = ring->end();
+    std::shared_lock lock(mutex_);
+    for (const auto& listener : listeners_) {
+        listener(instrument, *ring, first, end);
+    }
+}
+
+const TradeRing* TradeTape::find(const std::string& instrument) const {
+    std::shared_lock lock(mutex_);
+    auto it = rings_.find(instrument);
+    return it == rings_.end() ? nullptr : it->second.get();
+}
+
+void TradeTape::addListener(Listener listener) {
+    std::unique_lock lock(mutex_);
+    listeners_.push_back(std::move(listener));
+}
@@ -0,0 +1,347 @@
+#include "user_stream.h"
+#include "logger.h"
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+
+namespace beast = boost::beast;
+namespace asio = boost::asio;
+namespace websocket = beast::websocket;
+
+namespace {
+
+constexpr const char* kHost = "test.deribit.com";
+constexpr const char* kTarget = "/ws/api/v2";
+
+bool startsWith(const std::string& text, const char* prefix) {
+    return text.rfind(prefix, 0) == 0;
+}
+
+}  // namespace
+
+UserStream::UserStream(const std::string& client_id, const std::string& client_secret, OrderManager& orders,
+                       PositionKeeper* positions)
+    : client_id_(client_id), client_secret_(client_secret), orders_(orders), positions_(positions) {}
+
+UserStream::~UserStream() {
+    stop();
+}
+
+void UserStream::addTradeListener(TradeListener listener) {
+    trade_listeners_.push_back(std::move(listener));
+}
+
+void UserStream::addPositionListener(PositionListener listener) {
+    position_listeners_.push_back(std::move(listener));
+}
+
+void UserStream::addOrderListener(OrderListener listener) {
+    order_listeners_.push_back(std::move(listener));
+}
+
+void UserStream::setCancelOnDisconnect(bool enabled) {
+    cancel_on_disconnect_ = enabled;
+}
+
+void UserStream::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+    thread_ = std::thread(&UserStream::run, this);
+}
+
+void UserStream::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        running_ = false;
+    }
+    wait_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool UserStream::connected() const {
+    return connected_;
+}
+
+void UserStream::run() {
+    auto backoff = std::chrono::seconds(1);
+    while (running_) {
+        try {
+            session();
+        } catch (const std::exception& e) {
+            Logger::log("User stream disconnected: " + std::string(e.what()));
+        }
+        if (connected_.exchange(false)) {
+            backoff = std::chrono::seconds(1);
+        }
+        std::unique_lock<std::mutex> lock(wait_mutex_);
+        if (wait_cv_.wait_for(lock, backoff, [this] { return !running_; })) {
+            break;
+        }
+        backoff = std::min(backoff * 2, std::chrono::seconds(30));
+    }
+}
+
+// One connection: the read is asynchronous so the loop can notice stop()
+// and a silent server between messages; requests are written synchronously
+// from the same thread while no handler is running.
+void UserStream::session() {
+    asio::io_context ioc;
+    asio::ssl::context ctx(asio::ssl::context::tlsv12_client);
+    ctx.set_verify_mode(asio::ssl::verify_none);  // as for the REST client
+    websocket::stream<beast::ssl_stream<beast::tcp_stream>> ws(ioc, ctx);
+
+    asio::ip::tcp::resolver resolver(ioc);
+    beast::get_lowest_layer(ws).connect(resolver.resolve(kHost, "443"));
+    if (!SSL_set_tlsext_host_name(ws.next_layer().native_handle(), kHost)) {
+        throw std::runtime_error("Failed to set SNI host name.");
+    }
+    ws.next_layer().handshake(asio::ssl::stream_base::client);
+    ws.handshake(kHost, kTarget);
+    Logger::log("User stream connected, authenticating...");
+
+    outbox_.clear();
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        sent_.clear();
+        session_context_ = &ioc;
+    }
+    // Requests still awaiting a reply will not get one on this connection.
+    struct Detach {
+        UserStream* stream;
+        ~Detach() {
+            std::unordered_map<uint64_t, ReplyHandler> dropped;
+            {
+                std::lock_guard<std::mutex> lock(stream->send_mutex_);
+                stream->session_context_ = nullptr;
+                dropped.swap(stream->replies_);
+            }
+            Json::Value reply;
+            reply["error"]["message"] = "connection closed";
+            for (auto& pending : dropped) {
+                pending.second(reply);
+            }
+        }
+    } detach{this};
+
+    Json::Value auth;
+    auth["grant_type"] = "client_credentials";
+    auth["client_id"] = client_id_;
+    auth["client_secret"] = client_secret_;
+    auth_request_id_ = next_request_id_;
+    outbox_.push_back(request("public/auth", auth));
+
+    beast::flat_buffer buffer;
+    beast::error_code read_error;
+    bool reading = false;
+    auto last_message = std::chrono::steady_clock::now();
+    while (running_) {
+        {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            for (auto& text : sent_) {
+                outbox_.push_back(std::move(text));
+            }
+            sent_.clear();
+        }
+        for (const auto& text : outbox_) {
+            ws.write(asio::buffer(text));
+        }
+        outbox_.clear();
+
+        if (!reading) {
+            reading = true;
+            ws.async_read(buffer, [&](beast::error_code ec, std::size_t) {
+                reading = false;
+                read_error = ec;
+            });
+        }
+        if (ioc.stopped()) {
+            ioc.restart();
+        }
+        ioc.run_one_for(std::chrono::milliseconds(100));
+
+        auto now = std::chrono::steady_clock::now();
+        if (!reading) {
+            if (read_error) {
+                throw beast::system_error(read_error);
+            }
+            handleMessage(beast::buffers_to_string(buffer.data()));
+            buffer.consume(buffer.size());
+            last_message = now;
+        } else if (now - last_message > std::chrono::seconds(3 * kHeartbeatSeconds)) {
+            throw std::runtime_error("No messages from the exchange, reconnecting.");
+        }
+    }
+
+    beast::error_code ec;
+    beast::get_lowest_layer(ws).socket().shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+    beast::get_lowest_layer(ws).close();
+}
+
+bool UserStream::send(const std::string& method, const Json::Value& params, ReplyHandler on_reply) {
+    if (!connected_) {
+        return false;
+    }
+    uint64_t id = next_request_id_++;
+    std::string text = request(id, method, params);
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (!session_context_) {
+        return false;
+    }
+    if (on_reply) {
+        replies_[id] = std::move(on_reply);
+    }
+    sent_.push_back(std::move(text));
+    asio::post(*session_context_, [] {});  // ends the loop's wait so the request goes out now
+    return true;
+}
+
+std::string UserStream::request(const std::string& method, const Json::Value& params) {
+    return request(next_request_id_++, method, params);
+}
+
+std::string UserStream::request(uint64_t id, const std::string& method, const Json::Value& params) {
+    Json::Value message;
+    message["jsonrpc"] = "2.0";
+    message["id"] = Json::UInt64(id);
+    message["method"] = method;
+    message["params"] = params;
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    return Json::writeString(writer, message);
+}
+
+void UserStream::handleMessage(const std::string& text) {
+    Json::Value message;
+    Json::CharReaderBuilder readerBuilder;
+    std::istringstream stream(text);
+    std::string errors;
+    if (!Json::parseFromStream(readerBuilder, stream, &message, &errors)) {
+        Logger::log("Error parsing user stream message: " + errors);
+        return;
+    }
+
+    if (message.isMember("method")) {
+        const Json::Value& params = message["params"];
+        std::string method = message["method"].asString();
+        if (method == "subscription") {
+            handleNotification(params.get("channel", "").asString(), params["data"]);
+        } else if (method == "heartbeat" && params.get("type", "").asString() == "test_request") {
+            outbox_.push_back(request("public/test", Json::Value(Json::objectValue)));
+        }
+        return;
+    }
+
+    uint64_t id = message.get("id", 0).asUInt64();
+    ReplyHandler on_reply;
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        auto it = replies_.find(id);
+        if (it != replies_.end()) {
+            on_reply = std::move(it->second);
+            replies_.erase(it);
+        }
+    }
+    if (message.isMember("error")) {
+        std::string error = message["error"].get("message", "unknown error").asString();
+        if (id == auth_request_id_) {
+            throw std::runtime_error("User stream authentication failed: " + error);
+        }
+        Logger::log("User stream request " + std::to_string(id) + " failed: " + error);
+        if (on_reply) {
+            on_reply(message);
+        }
+        return;
+    }
+    if (on_reply) {
+        on_reply(message);
+        return;
+    }
+    if (id == auth_request_id_) {
+        connected_ = true;
+        Logger::log("User stream authenticated, subscribing to private channels.");
+        Json::Value channels(Json::arrayValue);
+        channels.append("user.orders.any.any.raw");
+        channels.append("user.trades.any.any.raw");
+        channels.append("user.changes.any.any.raw");
+        Json::Value subscribe;
+        subscribe["channels"] = channels;
+        outbox_.push_back(request("private/subscribe", subscribe));
+        if (cancel_on_disconnect_) {
+            Json::Value scope;
+            scope["scope"] = "connection";
+            outbox_.push_back(request("private/enable_cancel_on_disconnect", scope));
+        }
+        Json::Value heartbeat;
+        heartbeat["interval"] = kHeartbeatSeconds;
+        outbox_.push_back(request("public/set_heartbeat", heartbeat));
+    }
+}
+
+// user.orders carries one order (an array on aggregated intervals),
+// user.trades an array of our trades, and user.changes everything one
+// matching event touched in an instrument. Trades inside user.changes are
+// the same ones user.trades delivers, so they are not passed on twice.
+void UserStream::handleNotification(const std::string& channel, const Json::Value& data) {
+    auto applyOrder = [this](const Json::Value& order) {
+        orders_.applyOrderUpdate(order);
+        for (const auto& listener : order_listeners_) {
+            listener(order);
+        }
+    };
+    auto applyOrders = [&applyOrder](const Json::Value& orders) {
+        if (orders.isArray()) {
+            for (const auto& order : orders) {
+                applyOrder(order);
+            }
+        } else {
+            applyOrder(orders);
+        }
+    };
+
+    if (startsWith(channel, "user.orders.")) {
+        applyOrders(data);
+    } else if (startsWith(channel, "user.trades.")) {
+        for (const auto& trade : data) {
+            for (const auto& listener : trade_listeners_) {
+                listener(trade);
+            }
+        }
+    } else if (startsWith(channel, "user.changes.")) {
+        if (data.isMember("orders")) {
+            applyOrders(data["orders"]);
+        }
+        if (data.isMember("positions")) {
+            for (const auto& position : data["positions"]) {
+                applyPosition(position);
+            }
+        }
+    }
+}
+
+void UserStream::applyPosition(const Json::Value& position) {
+    if (!position.isObject()) {
+        return;
+    }
+    for (const auto& listener : position_listeners_) {
+        listener(position);
+    }
+    if (!positions_) {
+        return;
+    }
+    Position update;
+    update.instrument = position.get("instrument_name", "").asString();
+    update.size = position.get("size", 0.0).asDouble();
+    update.average_price = position.get("average_price", 0.0).asDouble();
+    update.mark_price = position.get("mark_price", 0.0).asDouble();
+    update.realized_pnl = position.get("realized_profit_loss", 0.0).asDouble();
+    if (!update.instrument.empty()) {
+        positions_->setPosition(update);
+    }
+}
@@ -1,9 +1,87 @@
 #include "websocket_server.h"
+#include "wire_protocol.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <map>
 #include <stdexcept>
 
-WebSocketServer::WebSocketServer(short port)
-    : acceptor_(io_context_, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)) {}
+namespace http = boost::beast::http;
+
+namespace {
+
+constexpr size_t kMaxQueuedMessages = 1024;
+constexpr auto kFlushTick = std::chrono::milliseconds(5);
+constexpr size_t kFlushSlots = 1024;
+
+uint64_t throttleKey(uint32_t index, uint32_t channel) {
+    return uint64_t{index} << 32 | channel;
+}
+
+// Value of the first key=value pair named key in the target's query string,
+// or false if there is none. A key without '=' has an empty value.
+bool queryParam(std::string_view target, std::string_view key, std::string_view& value) {
+    size_t start = target.find('?');
+    if (start == std::string_view::npos) {
+        return false;
+    }
+    std::string_view query = target.substr(start + 1);
+    query = query.substr(0, query.find('#'));
+    while (!query.empty()) {
+        size_t end = query.find('&');
+        std::string_view pair = query.substr(0, end);
+        size_t equals = pair.find('=');
+        if (pair.substr(0, equals) == key) {
+            value = equals == std::string_view::npos ? std::string_view() : pair.substr(equals + 1);
+            return true;
+        }
+        query = end == std::string_view::npos ? std::string_view() : query.substr(end + 1);
+    }
+    return false;
+}
+
+// Clients opt into shared deflate frames with ws://host:port/?compression=deflate
+bool wantsDeflate(std::string_view target) {
+    std::string_view compression;
+    return queryParam(target, "compression", compression) && compression == "deflate";
+}
+
+}  // namespace
+
+bool Session::subscribed(uint32_t channel) const {
+    size_t word = channel / 64;
+    return word < channels.size() && (channels[word] >> (channel % 64)) & 1;
+}
+
+bool Session::setSubscribed(uint32_t channel, bool on) {
+    size_t word = channel / 64;
+    if (word >= channels.size()) {
+        if (!on) {
+            return false;
+        }
+        channels.resize(word + 1, 0);
+    }
+    uint64_t bit = uint64_t{1} << (channel % 64);
+    bool was = (channels[word] & bit) != 0;
+    channels[word] = on ? channels[word] | bit : channels[word] & ~bit;
+    return was != on;
+}
+
+WebSocketServer::WebSocketServer(short port, size_t replay_depth)
+    : acceptor_(io_context_, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)),
+      flush_wheel_(kFlushTick, kFlushSlots),
+      flush_timer_(io_context_),
+      replay_depth_(std::max<size_t>(replay_depth, 1)) {}
+
+void WebSocketServer::setSubscriptionDemand(SubscriptionDemand* demand) {
+    demand_ = demand;
+}
+
+void WebSocketServer::setCandleSource(const CandleAggregator* candles) {
+    candles_ = candles;
+}
 
 void WebSocketServer::start() {
     running_ = true;
@@ -16,28 +94,296 @@ void WebSocketServer::stop() {
     io_context_.stop();
 }
 
-void WebSocketServer::broadcastOrderbook(const std::string& symbol, const json& orderbook) {
-    std::shared_lock lock(mutex_);
-    for (const auto& [ws, subscriptions] : subscriptions_) {
-        if (subscriptions.find(symbol) != subscriptions.end()) {
-            try {
-                ws->text(true);
-                ws->write(boost::asio::buffer(orderbook.dump()));
-            } catch (const std::exception& e) {
-                std::cerr << "Failed to send message to a client: " << e.what() << std::endl;
+// One published update. The JSON text is built by the producer; the binary
+// and deflated variants are encoded on the io_context thread the first time
+// a subscriber needs them and then shared by every such subscriber.
+struct WebSocketServer::Publication {
+    std::shared_ptr<const std::string> text;
+    std::function<void(std::string& out, uint32_t instrument_id)> encode_binary;  // empty: JSON only
+    std::shared_ptr<const std::string> variants[4];  // [binary * 2 + deflate]
+    uint64_t sequence = 0;                           // book deltas only
+    std::shared_ptr<const BookUpdate> update;        // book deltas only
+};
+
+namespace {
+
+const char* sideName(Side side) {
+    return side == Side::Bid ? "bid" : "ask";
+}
+
+}  // namespace
+
+// Deltas are encoded once here and shared by every subscriber; the replica
+// book they are applied to on the io_context thread serves snapshots, and the
+// publication itself is kept in the channel's replay ring for resumes.
+void WebSocketServer::broadcastOrderbook(const BookUpdate& update) {
+    auto shared_update = std::make_shared<const BookUpdate>(update);
+    auto publication = deltaPublication(shared_update, update.sequence - 1);
+
+    boost::asio::post(io_context_, [this, shared_update, publication]() {
+        uint32_t channel = channelId(shared_update->instrument);
+        BookChannel& book_channel = bookChannel(channel);
+        if (book_channel.groupings.empty()) {
+            book_channel.book.apply(*shared_update);
+        } else {
+            book_channel.book.apply(*shared_update, [&book_channel](const LevelDelta& delta, double previous) {
+                for (auto& grouping : book_channel.groupings) {
+                    applyToGrouping(*grouping, delta, previous);
+                }
+            });
+        }
+        book_channel.replay[publication->sequence % replay_depth_] = publication;
+        fanOut(channel, publication);
+        for (auto& grouping : book_channel.groupings) {
+            publishGrouping(*grouping, book_channel.book);
+        }
+    });
+}
+
+WebSocketServer::BookChannel& WebSocketServer::bookChannel(uint32_t channel) {
+    if (books_.size() <= channel) {
+        books_.resize(channel + 1);
+    }
+    if (!books_[channel]) {
+        books_[channel] = std::make_unique<BookChannel>(channel_names_[channel]);
+        books_[channel]->replay.resize(replay_depth_);
+    }
+    return *books_[channel];
+}
+
+// prev_sequence is the sequence the receiver must hold for the delta to
+// apply; it is more than one behind for conflated deltas.
+std::shared_ptr<WebSocketServer::Publication> WebSocketServer::deltaPublication(
+    std::shared_ptr<const BookUpdate> update, uint64_t prev_sequence) {
+    json changes = json::array();
+    for (const auto& delta : update->deltas) {
+        changes.push_back({sideName(delta.side), delta.price, delta.amount});
+    }
+    auto publication = std::make_shared<Publication>();
+    publication->text = std::make_shared<const std::string>(json{
+        {"type", "delta"},
+        {"channel", update->instrument},
+        {"sequence", update->sequence},
+        {"prev_sequence", prev_sequence},
+        {"timestamp", update->timestamp},
+        {"changes", std::move(changes)}
+    }.dump());
+    publication->sequence = update->sequence;
+    publication->encode_binary = [update](std::string& out, uint32_t instrument_id) {
+        wire::DeltaWriter writer(out, update->sequence, update->timestamp, instrument_id);
+        for (const auto& delta : update->deltas) {
+            writer.level(static_cast<uint8_t>(delta.side), delta.price, delta.amount);
+        }
+        writer.end();
+    };
+    publication->update = std::move(update);
+    return publication;
+}
+
+void WebSocketServer::broadcastAnalytics(const std::string& symbol, const json& analytics) {
+    auto publication = std::make_shared<Publication>();
+    publication->text = std::make_shared<const std::string>(
+        json{{"channel", "analytics." + symbol}, {"data", analytics}}.dump());
+    broadcast("analytics." + symbol, std::move(publication));
+}
+
+void WebSocketServer::broadcastBbo(const std::string& instrument, uint64_t sequence, int64_t timestamp,
+                                   double bid_price, double bid_amount, double ask_price, double ask_amount) {
+    std::string channel = "bbo." + instrument;
+    auto publication = std::make_shared<Publication>();
+    publication->text = std::make_shared<const std::string>(
+        json{{"channel", channel},
+             {"data", {{"sequence", sequence}, {"timestamp", timestamp}, {"bid_price", bid_price},
+                       {"bid_amount", bid_amount}, {"ask_price", ask_price}, {"ask_amount", ask_amount}}}}
+            .dump());
+    publication->encode_binary = [=](std::string& out, uint32_t instrument_id) {
+        wire::encodeBbo(out, sequence, timestamp, instrument_id, bid_price, bid_amount, ask_price, ask_amount);
+    };
+    broadcast(channel, std::move(publication));
+}
+
+// Binary subscribers get the batch as consecutive Trade messages in one frame.
+void WebSocketServer::broadcastTrades(const std::string& instrument, const std::vector<Trade>& trades) {
+    if (trades.empty()) {
+        return;
+    }
+    std::string channel = "trades." + instrument;
+    json data = json::array();
+    for (const auto& trade : trades) {
+        data.push_back({{"trade_seq", trade.trade_seq}, {"timestamp", trade.timestamp}, {"price", trade.price},
+                        {"amount", trade.amount}, {"direction", trade.side == Side::Bid ? "buy" : "sell"}});
+    }
+    auto publication = std::make_shared<Publication>();
+    publication->text = std::make_shared<const std::string>(json{{"channel", channel}, {"data", std::move(data)}}.dump());
+    auto batch = std::make_shared<const std::vector<Trade>>(trades);
+    publication->encode_binary = [batch](std::string& out, uint32_t instrument_id) {
+        for (const auto& trade : *batch) {
+            wire::encodeTrade(out, trade.trade_seq, trade.timestamp, instrument_id, trade.side == Side::Bid,
+                              trade.trade_id, trade.price, trade.amount);
+        }
+    };
+    broadcast(channel, std::move(publication));
+}
+
+void WebSocketServer::broadcastCandle(const std::string& instrument, const std::string& timeframe,
+                                      const Candle& candle) {
+    std::string channel = "candles." + instrument + "." + timeframe;
+    auto publication = std::make_shared<Publication>();
+    publication->text = std::make_shared<const std::string>(
+        json{{"type", "candle"}, {"channel", channel}, {"data", toJson(candle)}}.dump());
+    broadcast(channel, std::move(publication));
+}
+
+CompressionStats WebSocketServer::compressionStats() const {
+    CompressionStats stats;
+    stats.messages = compressed_messages_;
+    stats.frames_sent = compressed_frames_;
+    stats.bytes_in = compressed_bytes_in_;
+    stats.bytes_out = compressed_bytes_out_;
+    stats.bytes_saved = compressed_bytes_saved_;
+    stats.cpu_ns = compression_ns_;
+    return stats;
+}
+
+// Called from producer threads; the fan-out runs on the io_context thread.
+void WebSocketServer::broadcast(const std::string& channel, std::shared_ptr<Publication> publication) {
+    boost::asio::post(io_context_, [this, channel, publication]() {
+        auto it = channel_ids_.find(channel);
+        if (it == channel_ids_.end()) {
+            return;
+        }
+        fanOut(it->second, publication);
+    });
+}
+
+void WebSocketServer::fanOut(uint32_t channel, const std::shared_ptr<Publication>& publication) {
+    for (uint32_t index : channel_subscribers_[channel]) {
+        send(index, payloadFor(*publication, channel, *sessions_[index]));
+    }
+    for (uint32_t id : channel_throttles_[channel]) {
+        markDirty(id, publication);
+    }
+}
+
+OutboundMessage WebSocketServer::payloadFor(Publication& publication, uint32_t channel, const Session& session) {
+    bool binary = session.encoding == Encoding::Binary && publication.encode_binary;
+    auto& plain = publication.variants[binary ? 2 : 0];
+    if (!plain) {
+        if (binary) {
+            auto encoded = std::make_shared<std::string>();
+            publication.encode_binary(*encoded, channel);
+            plain = std::move(encoded);
+        } else {
+            plain = publication.text;
+        }
+    }
+    if (!session.deflate) {
+        return {plain, binary};
+    }
+    return deflated(publication.variants[binary ? 3 : 1], plain, binary);
+}
+
+// On deflate sessions every binary frame is deflated, so a client never has
+// to tell raw frames from compressed ones. JSON that fails to compress
+// still goes out as a text frame; binary that fails is dropped, and the
+// sequence gap sends the client back for a snapshot.
+OutboundMessage WebSocketServer::deflated(std::shared_ptr<const std::string>& cached,
+                                          const std::shared_ptr<const std::string>& plain, bool binary) {
+    if (!cached) {
+        cached = compress(*plain);
+    }
+    if (!cached) {
+        if (binary) {
+            std::cerr << "Dropping binary frame that failed to compress." << std::endl;
+            return {};
+        }
+        return {plain, false};
+    }
+    ++compressed_frames_;
+    compressed_bytes_saved_ += plain->size() - std::min(plain->size(), cached->size());
+    return {cached, true};
+}
+
+std::shared_ptr<const std::string> WebSocketServer::compress(const std::string& payload) {
+    auto start = std::chrono::steady_clock::now();
+    auto output = std::make_shared<std::string>();
+    if (!compressor_.compress(payload, *output)) {
+        return nullptr;
+    }
+    compression_ns_ += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    ++compressed_messages_;
+    compressed_bytes_in_ += payload.size();
+    compressed_bytes_out_ += output->size();
+    return output;
+}
+
+uint32_t WebSocketServer::acquireSession() {
+    uint32_t index;
+    if (!free_sessions_.empty()) {
+        index = free_sessions_.back();
+        free_sessions_.pop_back();
+    } else {
+        index = static_cast<uint32_t>(sessions_.size());
+        sessions_.push_back(std::make_unique<Session>());
+    }
+    Session& session = *sessions_[index];
+    session.ws.emplace(io_context_);
+    session.open = true;
+    session.writing = false;
+    session.refs = 1;
+    return index;
+}
+
+void WebSocketServer::retain(uint32_t index) {
+    ++sessions_[index]->refs;
+}
+
+// The slot goes back on the free list once the session is closed and its
+// last pending operation has completed; buffers keep their capacity.
+void WebSocketServer::release(uint32_t index) {
+    Session& session = *sessions_[index];
+    if (--session.refs != 0) {
+        return;
+    }
+    session.ws.reset();
+    session.read_buffer.consume(session.read_buffer.size());
+    session.upgrade_request = {};
+    session.write_queue.clear();
+    session.deflate = false;
+    session.encoding = Encoding::Json;
+    std::fill(session.channels.begin(), session.channels.end(), 0);
+    ++session.generation;
+    free_sessions_.push_back(index);
+}
+
+void WebSocketServer::closeSession(uint32_t index) {
+    Session& session = *sessions_[index];
+    if (!session.open) {
+        return;
+    }
+    session.open = false;
+    for (size_t word = 0; word < session.channels.size(); ++word) {
+        for (uint32_t bit = 0; bit < 64 && session.channels[word] >> bit != 0; ++bit) {
+            if ((session.channels[word] >> bit) & 1) {
+                removeSubscriber(index, static_cast<uint32_t>(word * 64 + bit));
             }
         }
     }
+    boost::system::error_code ec;
+    session.ws->next_layer().close(ec);
+    release(index);
 }
 
 void WebSocketServer::acceptConnections() {
-    auto ws = std::make_shared<websocket::stream<boost::asio::ip::tcp::socket>>(io_context_);
-    acceptor_.async_accept(ws->next_layer(), [this, ws](boost::system::error_code ec) {
+    uint32_t index = acquireSession();
+    acceptor_.async_accept(sessions_[index]->ws->next_layer(), [this, index](boost::system::error_code ec) {
         if (!ec) {
             std::cout << "New connection accepted." << std::endl;
-            handleConnection(ws);
+            handleConnection(index);
         } else {
             std::cerr << "Failed to accept connection: " << ec.message() << std::endl;
+            closeSession(index);
         }
         if (running_) {
             acceptConnections();
@@ -45,58 +391,714 @@ void WebSocketServer::acceptConnections() {
     });
 }
 
-void WebSocketServer::handleConnection(std::shared_ptr<websocket::stream<boost::asio::ip::tcp::socket>> ws) {
-    ws->async_accept([this, ws](boost::system::error_code ec) {
-        if (!ec) {
-            std::cout << "WebSocket handshake successful." << std::endl;
-            {
-                std::unique_lock lock(mutex_);
-                subscriptions_[ws] = {};
-            }
-            readMessages(ws);
-        } else {
+// The upgrade request is read first so per-client options in its target
+// can be applied before the handshake completes.
+void WebSocketServer::handleConnection(uint32_t index) {
+    Session& session = *sessions_[index];
+    retain(index);
+    http::async_read(session.ws->next_layer(), session.read_buffer, session.upgrade_request,
+                     [this, index](boost::system::error_code ec, std::size_t) {
+        Session& session = *sessions_[index];
+        if (ec || !session.open) {
             std::cerr << "WebSocket handshake failed: " << ec.message() << std::endl;
+            closeSession(index);
+            release(index);
+            return;
         }
+        auto target = session.upgrade_request.target();
+        session.deflate = wantsDeflate(std::string_view(target.data(), target.size()));
+        session.ws->async_accept(session.upgrade_request, [this, index](boost::system::error_code ec) {
+            if (!ec) {
+                std::cout << "WebSocket handshake successful." << std::endl;
+                readMessages(index);
+            } else {
+                std::cerr << "WebSocket handshake failed: " << ec.message() << std::endl;
+                closeSession(index);
+            }
+            release(index);
+        });
     });
 }
 
-void WebSocketServer::readMessages(std::shared_ptr<websocket::stream<boost::asio::ip::tcp::socket>> ws) {
-    auto buffer = std::make_shared<boost::beast::flat_buffer>();
-    ws->async_read(*buffer, [this, ws, buffer](boost::system::error_code ec, std::size_t) {
+void WebSocketServer::readMessages(uint32_t index) {
+    Session& session = *sessions_[index];
+    if (!session.open) {
+        return;
+    }
+    retain(index);
+    session.ws->async_read(session.read_buffer, [this, index](boost::system::error_code ec, std::size_t) {
+        Session& session = *sessions_[index];
         if (!ec) {
-            std::string message(boost::asio::buffer_cast<const char*>(buffer->data()), buffer->size());
-            buffer->consume(buffer->size());
-            handleClientMessage(ws, message);
-            readMessages(ws);
+            // flat_buffer storage is contiguous and reused across reads
+            auto data = session.read_buffer.data();
+            handleClientMessage(index, std::string_view(static_cast<const char*>(data.data()), data.size()));
+            session.read_buffer.consume(session.read_buffer.size());
+            readMessages(index);
         } else {
             std::cerr << "Error reading message: " << ec.message() << std::endl;
-            std::unique_lock lock(mutex_);
-            subscriptions_.erase(ws);
+            closeSession(index);
+        }
+        release(index);
+    });
+}
+
+void WebSocketServer::send(uint32_t index, OutboundMessage message) {
+    Session& session = *sessions_[index];
+    if (!session.open || !message.payload) {
+        return;
+    }
+    if (session.write_queue.size() >= kMaxQueuedMessages) {
+        std::cerr << "Dropping message for slow client." << std::endl;
+        return;
+    }
+    session.write_queue.push_back(std::move(message));
+    if (!session.writing) {
+        writeNext(index);
+    }
+}
+
+void WebSocketServer::writeNext(uint32_t index) {
+    Session& session = *sessions_[index];
+    if (!session.open || session.write_queue.empty()) {
+        session.writing = false;
+        return;
+    }
+    session.writing = true;
+    const OutboundMessage& message = session.write_queue.front();
+    session.ws->binary(message.binary);
+    retain(index);
+    session.ws->async_write(boost::asio::buffer(*message.payload),
+                            [this, index](boost::system::error_code ec, std::size_t) {
+        Session& session = *sessions_[index];
+        if (!ec) {
+            if (!session.write_queue.empty()) {
+                session.write_queue.pop_front();
+            }
+            writeNext(index);
+        } else {
+            std::cerr << "Failed to send message to a client: " << ec.message() << std::endl;
+            session.writing = false;
+            closeSession(index);
         }
+        release(index);
     });
 }
 
-void WebSocketServer::handleClientMessage(std::shared_ptr<websocket::stream<boost::asio::ip::tcp::socket>> ws, const std::string& message) {
-    try {
-        json request = json::parse(message);
-        if (request.contains("type") && request["type"] == "subscribe" && request.contains("symbol")) {
-            std::string symbol = request["symbol"];
-            {
-                std::unique_lock lock(mutex_);
-                subscriptions_[ws].insert(symbol);
+uint32_t WebSocketServer::channelId(std::string_view channel) {
+    auto it = channel_ids_.find(channel);
+    if (it != channel_ids_.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(channel_subscribers_.size());
+    channel_ids_.emplace(channel_names_.emplace_back(channel), id);
+    channel_subscribers_.emplace_back();
+    channel_throttles_.emplace_back();
+    return id;
+}
+
+bool WebSocketServer::addSubscriber(uint32_t index, uint32_t channel) {
+    if (!sessions_[index]->setSubscribed(channel, true)) {
+        return false;
+    }
+    if (channel_subscribers_[channel].empty() && channel_throttles_[channel].empty()) {
+        addGrouping(channel);
+        if (demand_) {
+            demand_->acquire(upstreamSymbol(channel_names_[channel]));
+        }
+    }
+    channel_subscribers_[channel].push_back(index);
+    if (sessions_[index]->encoding == Encoding::Binary) {
+        sendInstrumentDef(index, channel);
+    }
+    return true;
+}
+
+void WebSocketServer::removeSubscriber(uint32_t index, uint32_t channel) {
+    auto it = throttle_ids_.find(throttleKey(index, channel));
+    if (it != throttle_ids_.end()) {
+        releaseThrottle(it->second);
+    } else {
+        auto& subscribers = channel_subscribers_[channel];
+        subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), index), subscribers.end());
+    }
+    if (channel_subscribers_[channel].empty() && channel_throttles_[channel].empty()) {
+        removeGrouping(channel);
+        if (demand_) {
+            demand_->release(upstreamSymbol(channel_names_[channel]));
+        }
+    }
+}
+
+// "analytics.{symbol}", "bbo.{symbol}", "trades.{symbol}", the grouped and
+// the candle channels are fed by the same upstream instrument as "{symbol}".
+std::string WebSocketServer::upstreamSymbol(std::string_view channel) {
+    constexpr std::string_view prefixes[] = {"analytics.", "bbo.", "trades."};
+    std::string_view instrument;
+    std::string_view timeframe;
+    double bucket;
+    size_t depth;
+    if (parseGroupedChannel(channel, instrument, bucket, depth) ||
+        parseCandleChannel(channel, instrument, timeframe)) {
+        return std::string(instrument);
+    }
+    for (std::string_view prefix : prefixes) {
+        if (channel.substr(0, prefix.size()) == prefix) {
+            channel.remove_prefix(prefix.size());
+            break;
+        }
+    }
+    return std::string(channel);
+}
+
+bool WebSocketServer::parseCandleChannel(std::string_view channel, std::string_view& instrument,
+                                         std::string_view& timeframe) {
+    constexpr std::string_view prefix = "candles.";
+    if (channel.substr(0, prefix.size()) != prefix) {
+        return false;
+    }
+    channel.remove_prefix(prefix.size());
+    size_t dot = channel.rfind('.');
+    if (dot == std::string_view::npos || dot == 0 || dot + 1 == channel.size()) {
+        return false;
+    }
+    instrument = channel.substr(0, dot);
+    timeframe = channel.substr(dot + 1);
+    return true;
+}
+
+// book.grouped.{instrument}.{bucket}.{levels}; the bucket may itself
+// contain a '.', instrument names never do.
+bool WebSocketServer::parseGroupedChannel(std::string_view channel, std::string_view& instrument,
+                                          double& bucket, size_t& depth) {
+    constexpr std::string_view prefix = "book.grouped.";
+    constexpr size_t kMaxDepth = 1000;
+    if (channel.substr(0, prefix.size()) != prefix) {
+        return false;
+    }
+    channel.remove_prefix(prefix.size());
+    size_t first = channel.find('.');
+    size_t last = channel.rfind('.');
+    if (first == std::string_view::npos || first == 0 || last == first) {
+        return false;
+    }
+    instrument = channel.substr(0, first);
+    std::string bucket_text(channel.substr(first + 1, last - first - 1));
+    std::string depth_text(channel.substr(last + 1));
+    char* end = nullptr;
+    bucket = std::strtod(bucket_text.c_str(), &end);
+    if (bucket_text.empty() || *end != '\0' || !(bucket > 0.0)) {
+        return false;
+    }
+    unsigned long levels = std::strtoul(depth_text.c_str(), &end, 10);
+    if (depth_text.empty() || *end != '\0' || levels == 0 || levels > kMaxDepth) {
+        return false;
+    }
+    depth = levels;
+    return true;
+}
+
+// Subscribing again with a different interval (or none) changes the
+// throttle without resending the snapshot.
+// Channels are only created for instruments the exchange lists, so clients
+// cannot grow channel state or start upstream polling with arbitrary names.
+bool WebSocketServer::acceptChannel(uint32_t index, std::string_view channel) {
+    if (!demand_ || channel_ids_.count(channel) || demand_->known(upstreamSymbol(channel))) {
+        return true;
+    }
+    json error = {{"type", "error"}, {"channel", channel}, {"message", "unknown instrument"}};
+    send(index, {std::make_shared<const std::string>(error.dump()), false});
+    return false;
+}
+
+bool WebSocketServer::subscribe(uint32_t index, std::string_view channel, uint32_t interval_ms) {
+    if (!acceptChannel(index, channel)) {
+        return false;
+    }
+    uint32_t id = channelId(channel);
+    if (addSubscriber(index, id)) {
+        sendSnapshot(index, id);
+    }
+    setThrottle(index, id, interval_ms);
+    return true;
+}
+
+// Resuming also subscribes. Live deltas queue behind the replayed ones since
+// both are sent from the io_context thread.
+bool WebSocketServer::resume(uint32_t index, std::string_view channel, uint64_t last_seq, uint32_t interval_ms) {
+    if (!acceptChannel(index, channel)) {
+        return false;
+    }
+    uint32_t id = channelId(channel);
+    addSubscriber(index, id);
+    if (!replay(index, id, last_seq)) {
+        sendSnapshot(index, id);
+    }
+    auto it = throttle_ids_.find(throttleKey(index, id));
+    if (it != throttle_ids_.end() && id < books_.size() && books_[id]) {
+        throttles_[it->second].sent_sequence = books_[id]->book.sequence();
+        throttles_[it->second].dirty = false;
+    }
+    setThrottle(index, id, interval_ms);
+    return true;
+}
+
+// Sends the deltas after last_seq if all of them are still in the ring.
+bool WebSocketServer::replay(uint32_t index, uint32_t channel, uint64_t last_seq) {
+    if (channel >= books_.size() || !books_[channel]) {
+        return false;
+    }
+    const BookChannel& book_channel = *books_[channel];
+    uint64_t latest = book_channel.book.sequence();
+    if (last_seq > latest || latest - last_seq > replay_depth_) {
+        return false;
+    }
+    for (uint64_t seq = last_seq + 1; seq <= latest; ++seq) {
+        const auto& publication = book_channel.replay[seq % replay_depth_];
+        if (!publication || publication->sequence != seq) {
+            return false;
+        }
+    }
+    for (uint64_t seq = last_seq + 1; seq <= latest; ++seq) {
+        send(index, payloadFor(*book_channel.replay[seq % replay_depth_], channel, *sessions_[index]));
+    }
+    return true;
+}
+
+// Subscribers arriving between two updates share one encoding (and one
+// deflated copy) of the replica, so a subscribe storm costs a single encode.
+void WebSocketServer::sendSnapshot(uint32_t index, uint32_t channel) {
+    auto grouping = groupings_.find(channel);
+    if (grouping != groupings_.end()) {
+        if (grouping->second->current) {
+            send(index, payloadFor(*grouping->second->current, channel, *sessions_[index]));
+        }
+        return;
+    }
+    if (channel >= books_.size() || !books_[channel] || books_[channel]->book.sequence() == 0) {
+        return;
+    }
+    BookChannel& book_channel = *books_[channel];
+    if (book_channel.snapshot_sequence != book_channel.book.sequence()) {
+        for (auto& snapshot : book_channel.snapshots) {
+            snapshot.reset();
+        }
+        book_channel.snapshot_sequence = book_channel.book.sequence();
+    }
+    const Session& session = *sessions_[index];
+    bool binary = session.encoding == Encoding::Binary;
+    auto& plain = book_channel.snapshots[binary ? 2 : 0];
+    if (!plain) {
+        plain = encodeSnapshot(channel, session.encoding);
+    }
+    if (!session.deflate) {
+        send(index, {plain, binary});
+        return;
+    }
+    send(index, deflated(book_channel.snapshots[binary ? 3 : 1], plain, binary));
+}
+
+std::shared_ptr<const std::string> WebSocketServer::encodeSnapshot(uint32_t channel, Encoding encoding) const {
+    const OrderBook& book = books_[channel]->book;
+    auto out = std::make_shared<std::string>();
+    if (encoding == Encoding::Binary) {
+        wire::SnapshotWriter writer(*out, book.sequence(), book.timestamp(), channel);
+        for (const auto& [price, amount] : book.bids()) {
+            if (!writer.bid(price, amount)) {
+                break;
             }
-            std::cout << "Client subscribed to symbol: " << symbol << std::endl;
-        } else if (request.contains("type") && request["type"] == "unsubscribe" && request.contains("symbol")) {
-            std::string symbol = request["symbol"];
-            {
-                std::unique_lock lock(mutex_);
-                subscriptions_[ws].erase(symbol);
+        }
+        for (const auto& [price, amount] : book.asks()) {
+            if (!writer.ask(price, amount)) {
+                break;
             }
-            std::cout << "Client unsubscribed from symbol: " << symbol << std::endl;
+        }
+        writer.end();
+        return out;
+    }
+    json snapshot = book.toJson();
+    snapshot["type"] = "snapshot";
+    snapshot["channel"] = book.instrument();
+    *out = snapshot.dump();
+    return out;
+}
+
+// Binary subscribers learn the numeric id used for a channel's instrument.
+void WebSocketServer::sendInstrumentDef(uint32_t index, uint32_t channel) {
+    auto def = std::make_shared<std::string>();
+    wire::encodeInstrumentDef(*def, channel, channel_names_[channel]);
+    if (sessions_[index]->deflate) {
+        std::shared_ptr<const std::string> compressed;
+        send(index, deflated(compressed, def, true));
+        return;
+    }
+    send(index, {std::move(def), true});
+}
+
+void WebSocketServer::unsubscribe(uint32_t index, std::string_view channel) {
+    auto it = channel_ids_.find(channel);
+    if (it == channel_ids_.end() || !sessions_[index]->setSubscribed(it->second, false)) {
+        return;
+    }
+    removeSubscriber(index, it->second);
+}
+
+// Moves a subscriber between the per-update list and a conflation slot.
+void WebSocketServer::setThrottle(uint32_t index, uint32_t channel, uint32_t interval_ms) {
+    auto it = throttle_ids_.find(throttleKey(index, channel));
+    if (it != throttle_ids_.end()) {
+        if (interval_ms != 0) {
+            throttles_[it->second].interval_ms = interval_ms;
+            return;
+        }
+        flushThrottle(it->second);
+        releaseThrottle(it->second);
+        channel_subscribers_[channel].push_back(index);
+        return;
+    }
+    if (interval_ms == 0) {
+        return;
+    }
+    auto& subscribers = channel_subscribers_[channel];
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), index), subscribers.end());
+
+    uint32_t id;
+    if (!free_throttles_.empty()) {
+        id = free_throttles_.back();
+        free_throttles_.pop_back();
+    } else {
+        id = static_cast<uint32_t>(throttles_.size());
+        throttles_.emplace_back();
+    }
+    Throttle& throttle = throttles_[id];
+    throttle.session = index;
+    throttle.channel = channel;
+    throttle.interval_ms = interval_ms;
+    throttle.last_flush = TimerWheel::Clock::now();
+    throttle.sent_sequence = channel < books_.size() && books_[channel] ? books_[channel]->book.sequence() : 0;
+    throttle.dirty = false;
+    throttle.scheduled = false;
+    throttle_ids_.emplace(throttleKey(index, channel), id);
+    channel_throttles_[channel].push_back(id);
+}
+
+void WebSocketServer::releaseThrottle(uint32_t id) {
+    Throttle& throttle = throttles_[id];
+    auto& throttled = channel_throttles_[throttle.channel];
+    throttled.erase(std::remove(throttled.begin(), throttled.end(), id), throttled.end());
+    throttle_ids_.erase(throttleKey(throttle.session, throttle.channel));
+    throttle.latest.reset();
+    ++throttle.generation;
+    free_throttles_.push_back(id);
+}
+
+// The first update after a quiet interval goes out at once; later ones in
+// the same interval only mark the slot and are flushed by the timer wheel.
+void WebSocketServer::markDirty(uint32_t id, const std::shared_ptr<Publication>& publication) {
+    Throttle& throttle = throttles_[id];
+    throttle.dirty = true;
+    if (!publication->update) {
+        throttle.latest = publication;
+    }
+    if (throttle.scheduled) {
+        return;
+    }
+    auto due = throttle.last_flush + std::chrono::milliseconds(throttle.interval_ms);
+    if (due <= TimerWheel::Clock::now()) {
+        flushThrottle(id);
+        return;
+    }
+    throttle.scheduled = true;
+    flush_wheel_.schedule(due, uint64_t{throttle.generation} << 32 | id);
+    armFlushTimer();
+}
+
+void WebSocketServer::flushThrottle(uint32_t id) {
+    Throttle& throttle = throttles_[id];
+    throttle.scheduled = false;
+    if (!throttle.dirty) {
+        return;
+    }
+    throttle.dirty = false;
+    throttle.last_flush = TimerWheel::Clock::now();
+    uint32_t channel = throttle.channel;
+    if (channel < books_.size() && books_[channel]) {
+        uint64_t latest = books_[channel]->book.sequence();
+        if (throttle.sent_sequence == latest) {
+            return;
+        }
+        if (auto publication = conflate(channel, throttle.sent_sequence)) {
+            send(throttle.session, payloadFor(*publication, channel, *sessions_[throttle.session]));
         } else {
-            std::cerr << "Unknown message type or malformed message." << std::endl;
+            sendSnapshot(throttle.session, channel);
+        }
+        throttle.sent_sequence = latest;
+    } else if (throttle.latest) {
+        send(throttle.session, payloadFor(*throttle.latest, channel, *sessions_[throttle.session]));
+        throttle.latest.reset();
+    }
+}
+
+// Merges the ring's deltas after from into one, last write per level
+// winning. Null when they are no longer all in the ring.
+std::shared_ptr<WebSocketServer::Publication> WebSocketServer::conflate(uint32_t channel, uint64_t from) {
+    const BookChannel& book_channel = *books_[channel];
+    uint64_t latest = book_channel.book.sequence();
+    if (from >= latest || latest - from > replay_depth_) {
+        return nullptr;
+    }
+    for (uint64_t seq = from + 1; seq <= latest; ++seq) {
+        const auto& publication = book_channel.replay[seq % replay_depth_];
+        if (!publication || publication->sequence != seq) {
+            return nullptr;
+        }
+    }
+    if (latest - from == 1) {
+        return book_channel.replay[latest % replay_depth_];
+    }
+    for (const auto& conflated : conflated_) {
+        if (conflated.channel == channel && conflated.from == from && conflated.to == latest) {
+            return conflated.publication;
+        }
+    }
+    std::map<std::pair<Side, double>, double> levels;
+    for (uint64_t seq = from + 1; seq <= latest; ++seq) {
+        for (const auto& delta : book_channel.replay[seq % replay_depth_]->update->deltas) {
+            levels[{delta.side, delta.price}] = delta.amount;
+        }
+    }
+    auto merged = std::make_shared<BookUpdate>();
+    merged->instrument = book_channel.book.instrument();
+    merged->sequence = latest;
+    merged->timestamp = book_channel.book.timestamp();
+    merged->deltas.reserve(levels.size());
+    for (const auto& [level, amount] : levels) {
+        merged->deltas.push_back({level.first, level.second, amount});
+    }
+    auto publication = deltaPublication(std::move(merged), from);
+    conflated_.push_back({channel, from, latest, publication});
+    return publication;
+}
+
+// History is read straight from the aggregator and may be ahead of candle
+// messages still queued; each of those carries the whole candle, so a
+// client converges on the next update.
+void WebSocketServer::sendCandleHistory(uint32_t index, std::string_view channel, size_t limit) {
+    constexpr size_t kMaxHistory = 5000;
+    std::string_view instrument;
+    std::string_view timeframe;
+    if (!candles_ || !parseCandleChannel(channel, instrument, timeframe) || !candles_->hasTimeframe(timeframe)) {
+        std::cerr << "History requested for unknown candle channel: " << channel << std::endl;
+        return;
+    }
+    json candles = json::array();
+    for (const auto& candle : candles_->history(std::string(instrument), timeframe,
+                                                std::min(limit == 0 ? kMaxHistory : limit, kMaxHistory))) {
+        candles.push_back(toJson(candle));
+    }
+    auto payload = std::make_shared<const std::string>(
+        json{{"type", "candles"}, {"channel", channel}, {"data", std::move(candles)}}.dump());
+    if (sessions_[index]->deflate) {
+        if (auto compressed = compress(*payload)) {
+            send(index, {std::move(compressed), true});
+            return;
+        }
+    }
+    send(index, {std::move(payload), false});
+}
+
+// Built from the replica when a grouped channel gets its first subscriber;
+// incremental after that.
+void WebSocketServer::addGrouping(uint32_t channel) {
+    std::string_view instrument;
+    double bucket;
+    size_t depth;
+    if (groupings_.count(channel) || !parseGroupedChannel(channel_names_[channel], instrument, bucket, depth)) {
+        return;
+    }
+    uint32_t book_id = channelId(instrument);
+    BookChannel& book_channel = bookChannel(book_id);
+    auto grouping = std::make_unique<Grouping>();
+    grouping->channel = channel;
+    grouping->book_channel = book_id;
+    grouping->bucket = bucket;
+    grouping->depth = depth;
+    for (const auto& [price, amount] : book_channel.book.bids()) {
+        applyToGrouping(*grouping, {Side::Bid, price, amount}, 0.0);
+    }
+    for (const auto& [price, amount] : book_channel.book.asks()) {
+        applyToGrouping(*grouping, {Side::Ask, price, amount}, 0.0);
+    }
+    publishGrouping(*grouping, book_channel.book);
+    groupings_.emplace(channel, grouping.get());
+    book_channel.groupings.push_back(std::move(grouping));
+}
+
+void WebSocketServer::removeGrouping(uint32_t channel) {
+    auto it = groupings_.find(channel);
+    if (it == groupings_.end()) {
+        return;
+    }
+    auto& groupings = books_[it->second->book_channel]->groupings;
+    groupings.erase(std::remove_if(groupings.begin(), groupings.end(),
+                                   [channel](const auto& grouping) { return grouping->channel == channel; }),
+                    groupings.end());
+    groupings_.erase(it);
+}
+
+// Buckets count their levels so they are dropped exactly when empty rather
+// than when a floating-point sum happens to reach zero.
+void WebSocketServer::applyToGrouping(Grouping& grouping, const LevelDelta& delta, double previous_amount) {
+    double scaled = delta.price / grouping.bucket;
+    auto update = [&](auto& buckets, int64_t key) {
+        auto& bucket = buckets[key];
+        bucket.amount += delta.amount - previous_amount;
+        if (previous_amount == 0.0 && delta.amount != 0.0) {
+            ++bucket.levels;
+        } else if (previous_amount != 0.0 && delta.amount == 0.0 && bucket.levels > 0) {
+            --bucket.levels;
+        }
+        if (bucket.levels == 0) {
+            buckets.erase(key);
+        }
+    };
+    if (delta.side == Side::Bid) {
+        update(grouping.bids, static_cast<int64_t>(std::floor(scaled + 1e-9)));
+    } else {
+        update(grouping.asks, static_cast<int64_t>(std::ceil(scaled - 1e-9)));
+    }
+}
+
+// Publishes only when the visible top levels changed; the message is built
+// once and shared by every subscriber of the grouping.
+void WebSocketServer::publishGrouping(Grouping& grouping, const OrderBook& book) {
+    if (book.sequence() == 0) {
+        return;
+    }
+    auto top = [&grouping](const auto& buckets, std::vector<PriceLevel>& out) {
+        std::vector<PriceLevel> levels;
+        levels.reserve(std::min(grouping.depth, buckets.size()));
+        for (const auto& [key, bucket] : buckets) {
+            if (levels.size() >= grouping.depth) {
+                break;
+            }
+            levels.push_back({static_cast<double>(key) * grouping.bucket, bucket.amount});
+        }
+        bool changed = levels.size() != out.size() ||
+                       !std::equal(levels.begin(), levels.end(), out.begin(), [](const PriceLevel& a, const PriceLevel& b) {
+                           return a.price == b.price && a.amount == b.amount;
+                       });
+        out = std::move(levels);
+        return changed;
+    };
+    bool bids_changed = top(grouping.bids, grouping.top_bids);
+    bool asks_changed = top(grouping.asks, grouping.top_asks);
+    if (grouping.current && !bids_changed && !asks_changed) {
+        return;
+    }
+    auto levelsJson = [](const std::vector<PriceLevel>& levels) {
+        json out = json::array();
+        for (const auto& level : levels) {
+            out.push_back({level.price, level.amount});
+        }
+        return out;
+    };
+    auto publication = std::make_shared<Publication>();
+    publication->text = std::make_shared<const std::string>(json{
+        {"type", "grouped"},
+        {"channel", channel_names_[grouping.channel]},
+        {"sequence", book.sequence()},
+        {"timestamp", book.timestamp()},
+        {"bucket", grouping.bucket},
+        {"bids", levelsJson(grouping.top_bids)},
+        {"asks", levelsJson(grouping.top_asks)}
+    }.dump());
+    publication->encode_binary = [bids = grouping.top_bids, asks = grouping.top_asks,
+                                  sequence = book.sequence(), timestamp = book.timestamp()](std::string& out, uint32_t id) {
+        wire::SnapshotWriter writer(out, sequence, timestamp, id);
+        for (const auto& level : bids) {
+            if (!writer.bid(level.price, level.amount)) {
+                break;
+            }
+        }
+        for (const auto& level : asks) {
+            if (!writer.ask(level.price, level.amount)) {
+                break;
+            }
+        }
+        writer.end();
+    };
+    grouping.current = publication;
+    fanOut(grouping.channel, publication);
+}
+
+void WebSocketServer::armFlushTimer() {
+    if (flush_armed_ || flush_wheel_.empty()) {
+        return;
+    }
+    flush_armed_ = true;
+    flush_timer_.expires_after(flush_wheel_.tick());
+    flush_timer_.async_wait([this](boost::system::error_code ec) {
+        flush_armed_ = false;
+        if (ec) {
+            return;
+        }
+        flush_wheel_.advance(TimerWheel::Clock::now(), [this](uint64_t timer) {
+            auto id = static_cast<uint32_t>(timer);
+            if (throttles_[id].generation == timer >> 32) {
+                flushThrottle(id);
+            }
+        });
+        conflated_.clear();
+        armFlushTimer();
+    });
+}
+
+void WebSocketServer::setEncoding(uint32_t index, Encoding encoding) {
+    Session& session = *sessions_[index];
+    if (session.encoding == encoding) {
+        return;
+    }
+    session.encoding = encoding;
+    if (encoding == Encoding::Binary) {
+        for (uint32_t channel = 0; channel < channel_subscribers_.size(); ++channel) {
+            if (session.subscribed(channel)) {
+                sendInstrumentDef(index, channel);
+            }
+        }
+    }
+}
+
+void WebSocketServer::handleClientMessage(uint32_t index, std::string_view message) {
+    ControlMessage request;
+    if (!parseControlMessage(message, request)) {
+        std::cerr << "Failed to handle client message: malformed control message." << std::endl;
+        return;
+    }
+    if (request.type == ControlType::Subscribe && !request.symbol.empty()) {
+        if (!request.encoding.empty()) {
+            setEncoding(index, request.encoding == "binary" ? Encoding::Binary : Encoding::Json);
+        }
+        if (subscribe(index, request.symbol, request.interval_ms)) {
+            std::cout << "Client subscribed to symbol: " << request.symbol << std::endl;
+        }
+    } else if (request.type == ControlType::Unsubscribe && !request.symbol.empty()) {
+        unsubscribe(index, request.symbol);
+        std::cout << "Client unsubscribed from symbol: " << request.symbol << std::endl;
+    } else if (request.type == ControlType::Snapshot && !request.symbol.empty()) {
+        auto it = channel_ids_.find(request.symbol);
+        if (it != channel_ids_.end() && sessions_[index]->subscribed(it->second)) {
+            sendSnapshot(index, it->second);
+        }
+    } else if (request.type == ControlType::Resume && !request.symbol.empty()) {
+        if (resume(index, request.symbol, request.last_seq, request.interval_ms)) {
+            std::cout << "Client resumed symbol: " << request.symbol << " after sequence " << request.last_seq << std::endl;
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Failed to handle client message: " << e.what() << std::endl;
+    } else if (request.type == ControlType::History && !request.symbol.empty()) {
+        sendCandleHistory(index, request.symbol, request.limit);
+    } else if (request.type == ControlType::Compression) {
+        sessions_[index]->deflate = request.mode == "deflate";
+        std::cout << "Client compression set to: " << (sessions_[index]->deflate ? "deflate" : "none") << std::endl;
+    } else {
+        std::cerr << "Unknown message type or malformed message." << std::endl;
     }
 }